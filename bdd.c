@@ -0,0 +1,505 @@
+/*
+ * bdd.c - Binary decision diagrams for the Boolean Expression Solver
+ *
+ * Implements the reduced ordered BDD engine declared in boolsolve.h: a node
+ * pool with a unique table that keeps every node distinct, a lossy cache of
+ * operation results, the construction of a BDD from a compiled Program, and
+ * the satisfiability, model counting and equivalence queries built on it.
+ * None of them enumerate the 2^var_count rows of a truth table.
+ */
+
+ #include "boolsolve.h"
+
+ #include <stdlib.h>
+ #include <string.h>
+
+ #define BDD_INITIAL_NODES 1024
+
+ /* -------------------------------------------------------------------------
+  * hash_bdd:
+  *   Hashes a (level, low, high) node or an (op, f, g) operation.
+  * ------------------------------------------------------------------------- */
+ static unsigned hash_bdd(int a, int b, int c) {
+     unsigned h = (unsigned)a * 0x9E3779B1u;
+     h = (h ^ (unsigned)b) * 0x85EBCA6Bu;
+     h = (h ^ (unsigned)c) * 0xC2B2AE35u;
+     return h ^ (h >> 16);
+ }
+
+ /* -------------------------------------------------------------------------
+  * bdd_grow:
+  *   Doubles the node pool, and rebuilds the unique table and the operation
+  *   cache to match its new size.
+  *
+  *   Returns:
+  *     0 on success, -1 (with the error flag set) if memory or the node
+  *     limit ran out.
+  * ------------------------------------------------------------------------- */
+ static int bdd_grow(Bdd *bdd) {
+     if (bdd->capacity >= bdd->max_nodes) {
+         bdd->error = 1;
+         return -1;
+     }
+     int capacity = bdd->capacity * 2;
+     if (capacity > bdd->max_nodes) {
+         capacity = bdd->max_nodes;
+     }
+     BddNode *nodes = realloc(bdd->nodes, (size_t)capacity * sizeof(BddNode));
+     if (!nodes) {
+         bdd->error = 1;
+         return -1;
+     }
+     bdd->nodes = nodes;
+     bdd->capacity = capacity;
+
+     // Keep the unique table at most half full
+     int size = bdd->unique_size;
+     while (size < 2 * capacity) {
+         size *= 2;
+     }
+     if (size != bdd->unique_size) {
+         int *unique = malloc((size_t)size * sizeof(int));
+         if (!unique) {
+             bdd->error = 1;
+             return -1;
+         }
+         memset(unique, 0xff, (size_t)size * sizeof(int));
+         unsigned mask = (unsigned)size - 1;
+         for (int i = 2; i < bdd->count; i++) {
+             unsigned h = hash_bdd(nodes[i].level, nodes[i].low, nodes[i].high) & mask;
+             while (unique[h] >= 0) {
+                 h = (h + 1) & mask;
+             }
+             unique[h] = i;
+         }
+         free(bdd->unique);
+         bdd->unique = unique;
+         bdd->unique_size = size;
+     }
+
+     // The cache is lossy, so a bigger one simply starts out empty
+     if (bdd->cache_size < capacity) {
+         BddCacheEntry *cache = realloc(bdd->cache, (size_t)capacity * sizeof(BddCacheEntry));
+         if (cache) {
+             memset(cache, 0xff, (size_t)capacity * sizeof(BddCacheEntry));
+             bdd->cache = cache;
+             bdd->cache_size = capacity;
+         }
+     }
+     return 0;
+ }
+
+ /* -------------------------------------------------------------------------
+  * bdd_node:
+  *   Returns the node that tests 'level' and continues with 'low' when that
+  *   variable is 0 and with 'high' when it is 1, creating it only if no equal
+  *   node exists yet. A test whose two outcomes agree is dropped.
+  *
+  *   Returns:
+  *     The node, or BDD_FALSE (with the error flag set) if memory or the
+  *     node limit ran out.
+  * ------------------------------------------------------------------------- */
+ static int bdd_node(Bdd *bdd, int level, int low, int high) {
+     if (low == high) {
+         return low;
+     }
+     if (bdd->count == bdd->capacity && bdd_grow(bdd) != 0) {
+         return BDD_FALSE;
+     }
+     unsigned mask = (unsigned)bdd->unique_size - 1;
+     unsigned h = hash_bdd(level, low, high) & mask;
+     for (int i; (i = bdd->unique[h]) >= 0; h = (h + 1) & mask) {
+         const BddNode *n = &bdd->nodes[i];
+         if (n->level == level && n->low == low && n->high == high) {
+             return i;
+         }
+     }
+     int i = bdd->count++;
+     bdd->nodes[i] = (BddNode){ level, low, high };
+     bdd->unique[h] = i;
+     return i;
+ }
+
+ /* -------------------------------------------------------------------------
+  * bdd_init:
+  *   Prepares an empty BDD over 'var_count' variables, holding only the two
+  *   constants. Levels 0 .. var_count - 1 are tested in that order.
+  *
+  *   Returns:
+  *     0 on success, -1 if var_count is too large or memory ran out.
+  * ------------------------------------------------------------------------- */
+ int bdd_init(Bdd *bdd, int var_count) {
+     memset(bdd, 0, sizeof(*bdd));
+     if (var_count < 0 || var_count >= MAX_VARS) {
+         return -1;
+     }
+     bdd->var_count = var_count;
+     bdd->max_nodes = BDD_MAX_NODES;
+     bdd->capacity = BDD_INITIAL_NODES;
+     bdd->unique_size = 2 * BDD_INITIAL_NODES;
+     bdd->cache_size = BDD_INITIAL_NODES;
+     bdd->nodes = malloc((size_t)bdd->capacity * sizeof(BddNode));
+     bdd->unique = malloc((size_t)bdd->unique_size * sizeof(int));
+     bdd->cache = malloc((size_t)bdd->cache_size * sizeof(BddCacheEntry));
+     if (!bdd->nodes || !bdd->unique || !bdd->cache) {
+         bdd_free(bdd);
+         return -1;
+     }
+     memset(bdd->unique, 0xff, (size_t)bdd->unique_size * sizeof(int));
+     memset(bdd->cache, 0xff, (size_t)bdd->cache_size * sizeof(BddCacheEntry));
+     bdd->nodes[BDD_FALSE] = (BddNode){ var_count, BDD_FALSE, BDD_FALSE };
+     bdd->nodes[BDD_TRUE] = (BddNode){ var_count, BDD_TRUE, BDD_TRUE };
+     bdd->count = 2;
+     return 0;
+ }
+
+ /* -------------------------------------------------------------------------
+  * bdd_free:
+  *   Frees every node of a BDD.
+  * ------------------------------------------------------------------------- */
+ void bdd_free(Bdd *bdd) {
+     free(bdd->nodes);
+     free(bdd->unique);
+     free(bdd->cache);
+     bdd->nodes = NULL;
+     bdd->unique = NULL;
+     bdd->cache = NULL;
+     bdd->count = bdd->capacity = 0;
+ }
+
+ /* -------------------------------------------------------------------------
+  * bdd_var:
+  *   Returns the function that is true exactly when the variable at 'level'
+  *   is 1.
+  * ------------------------------------------------------------------------- */
+ int bdd_var(Bdd *bdd, int level) {
+     return bdd_node(bdd, level, BDD_FALSE, BDD_TRUE);
+ }
+
+ /* -------------------------------------------------------------------------
+  * bdd_apply:
+  *   Combines two functions with BDD_AND, BDD_OR or BDD_XOR, splitting both
+  *   on their topmost variable and combining the halves. Every pair of nodes
+  *   is combined at most once per cache lifetime, which bounds the work by
+  *   the product of the two sizes.
+  *
+  *   Returns:
+  *     The result, or BDD_FALSE (with the error flag set) if memory or the
+  *     node limit ran out.
+  * ------------------------------------------------------------------------- */
+ int bdd_apply(Bdd *bdd, int op, int f, int g) {
+     switch (op) {
+         case BDD_AND:
+             if (f == g || g == BDD_TRUE) return f;
+             if (f == BDD_TRUE) return g;
+             if (f == BDD_FALSE || g == BDD_FALSE) return BDD_FALSE;
+             break;
+         case BDD_OR:
+             if (f == g || g == BDD_FALSE) return f;
+             if (f == BDD_FALSE) return g;
+             if (f == BDD_TRUE || g == BDD_TRUE) return BDD_TRUE;
+             break;
+         default:
+             if (f == g) return BDD_FALSE;
+             if (g == BDD_FALSE) return f;
+             if (f == BDD_FALSE) return g;
+             break;
+     }
+     if (bdd->error) {
+         return BDD_FALSE;
+     }
+     // All three operations commute
+     if (f > g) {
+         int t = f;
+         f = g;
+         g = t;
+     }
+     unsigned h = hash_bdd(op, f, g);
+     const BddCacheEntry *hit = &bdd->cache[h & ((unsigned)bdd->cache_size - 1)];
+     if (hit->op == op && hit->f == f && hit->g == g) {
+         return hit->result;
+     }
+
+     BddNode nf = bdd->nodes[f], ng = bdd->nodes[g];
+     int level = nf.level < ng.level ? nf.level : ng.level;
+     int f0 = nf.level == level ? nf.low : f, f1 = nf.level == level ? nf.high : f;
+     int g0 = ng.level == level ? ng.low : g, g1 = ng.level == level ? ng.high : g;
+     int low = bdd_apply(bdd, op, f0, g0);
+     int high = bdd_apply(bdd, op, f1, g1);
+     int result = bdd_node(bdd, level, low, high);
+     if (bdd->error) {
+         return BDD_FALSE;
+     }
+
+     // The recursion may have resized the cache
+     BddCacheEntry *slot = &bdd->cache[h & ((unsigned)bdd->cache_size - 1)];
+     *slot = (BddCacheEntry){ op, f, g, result };
+     return result;
+ }
+
+ /* -------------------------------------------------------------------------
+  * bdd_not:
+  *   Returns the negation of a function.
+  * ------------------------------------------------------------------------- */
+ int bdd_not(Bdd *bdd, int f) {
+     return bdd_apply(bdd, BDD_XOR, f, BDD_TRUE);
+ }
+
+ /* -------------------------------------------------------------------------
+  * bdd_from_program:
+  *   Builds the function a compiled Program computes by running its postfix
+  *   code over BDDs instead of bits.
+  *
+  *   Parameters:
+  *     bdd    - A BDD with at least as many levels as the program has
+  *              variables.
+  *     prog   - The compiled expression.
+  *     levels - The level of each of the program's slots, or NULL to put
+  *              slot j at level j.
+  *
+  *   Returns:
+  *     The function, or -1 if memory or the node limit ran out.
+  * ------------------------------------------------------------------------- */
+ int bdd_from_program(Bdd *bdd, const Program *prog, const int *levels) {
+     int small[64];
+     int needed = prog->max_depth + prog->slot_count + 1;
+     int *stack = needed <= 64 ? small : malloc((size_t)needed * sizeof(int));
+     if (!stack) {
+         return -1;
+     }
+     int *slots = stack + prog->max_depth;
+     int top = 0;
+
+     for (int i = 0; i < prog->length && !bdd->error; i++) {
+         const Instr *in = &prog->code[i];
+         switch (in->op) {
+             case OP_CONST:
+                 stack[top++] = in->arg ? BDD_TRUE : BDD_FALSE;
+                 break;
+             case OP_VAR: {
+                 // Bit 'arg' of an assignment belongs to slot var_count - arg - 1
+                 int slot = prog->var_count - (int)in->arg - 1;
+                 stack[top++] = bdd_var(bdd, levels ? levels[slot] : slot);
+                 break;
+             }
+             case OP_NOT:
+                 stack[top - 1] = bdd_not(bdd, stack[top - 1]);
+                 break;
+             case OP_AND:
+                 top--;
+                 stack[top - 1] = bdd_apply(bdd, BDD_AND, stack[top - 1], stack[top]);
+                 break;
+             case OP_OR:
+                 top--;
+                 stack[top - 1] = bdd_apply(bdd, BDD_OR, stack[top - 1], stack[top]);
+                 break;
+             case OP_STORE:
+                 slots[in->arg] = stack[top - 1];
+                 break;
+             case OP_LOAD:
+                 stack[top++] = slots[in->arg];
+                 break;
+         }
+     }
+     int result = top > 0 ? stack[top - 1] : BDD_FALSE;
+     if (stack != small) {
+         free(stack);
+     }
+     return bdd->error ? -1 : result;
+ }
+
+ /* -------------------------------------------------------------------------
+  * bdd_count:
+  *   Counts the assignments of all var_count variables that satisfy 'f'.
+  *   A node's children always precede it in the pool, so one forward pass
+  *   counts every node below 'f', each from the counts of its children.
+  *
+  *   Returns:
+  *     0 on success, -1 if memory ran out.
+  * ------------------------------------------------------------------------- */
+ int bdd_count(const Bdd *bdd, int f, uint64_t *count) {
+     const BddNode *nodes = bdd->nodes;
+     uint64_t *counts = malloc((size_t)(f + 1 > 2 ? f + 1 : 2) * sizeof(uint64_t));
+     if (!counts) {
+         return -1;
+     }
+     // counts[i] is taken over the variables from node i's level down
+     counts[BDD_FALSE] = 0;
+     counts[BDD_TRUE] = 1;
+     for (int i = 2; i <= f; i++) {
+         const BddNode *n = &nodes[i];
+         counts[i] = (counts[n->low] << (nodes[n->low].level - n->level - 1))
+                   + (counts[n->high] << (nodes[n->high].level - n->level - 1));
+     }
+     *count = counts[f] << nodes[f].level;
+     free(counts);
+     return 0;
+ }
+
+ /* -------------------------------------------------------------------------
+  * bdd_satisfy:
+  *   Finds one assignment that satisfies 'f', which must not be BDD_FALSE,
+  *   by following any path to BDD_TRUE. Variables the path does not test
+  *   are 0.
+  *
+  *   Returns:
+  *     The assignment, with level l in bit (var_count - l - 1).
+  * ------------------------------------------------------------------------- */
+ uint64_t bdd_satisfy(const Bdd *bdd, int f) {
+     uint64_t model = 0;
+     while (f > BDD_TRUE) {
+         const BddNode *n = &bdd->nodes[f];
+         if (n->low != BDD_FALSE) {
+             f = n->low;
+         } else {
+             model |= 1ULL << (bdd->var_count - n->level - 1);
+             f = n->high;
+         }
+     }
+     return model;
+ }
+
+ /* -------------------------------------------------------------------------
+  * bdd_evaluate:
+  *   Evaluates 'f' for one assignment, laid out as for bdd_satisfy.
+  * ------------------------------------------------------------------------- */
+ int bdd_evaluate(const Bdd *bdd, int f, uint64_t assignment) {
+     while (f > BDD_TRUE) {
+         const BddNode *n = &bdd->nodes[f];
+         f = (assignment >> (bdd->var_count - n->level - 1)) & 1 ? n->high : n->low;
+     }
+     return f;
+ }
+
+ /* -------------------------------------------------------------------------
+  * bdd_analyze:
+  *   Answers satisfiability and model counting for one expression, or
+  *   equivalence for two. With a second expression the query is about
+  *   their exclusive or, which is satisfied exactly where they differ; the
+  *   variables are those of the first expression followed by any new ones
+  *   of the second, in order of first appearance.
+  *
+  *   Parameters:
+  *     expr   - The Boolean expression as a string.
+  *     expr2  - A second expression to compare it with, or NULL.
+  *     result - Receives the variables, whether a satisfying (or differing)
+  *              assignment exists, one such assignment laid out as a
+  *              truth-table row, the value of expr there, and their count.
+  *
+  *   Returns:
+  *     0 on success, -1 if memory or the node limit ran out.
+  * ------------------------------------------------------------------------- */
+ int bdd_analyze(const char *expr, const char *expr2, BddResult *result) {
+     Program prog, prog2;
+     memset(result, 0, sizeof(*result));
+     if (compile_expression(expr, &prog) != 0) {
+         return -1;
+     }
+     if (expr2 && compile_expression(expr2, &prog2) != 0) {
+         free_program(&prog);
+         return -1;
+     }
+
+     // Give the second expression's variables the levels of the first
+     int levels[MAX_VARS];
+     memcpy(result->vars, prog.vars, (size_t)prog.var_count);
+     result->var_count = prog.var_count;
+     for (int j = 0; expr2 && j < prog2.var_count; j++) {
+         int level = 0;
+         while (level < result->var_count && result->vars[level] != prog2.vars[j]) {
+             level++;
+         }
+         if (level == result->var_count) {
+             result->vars[result->var_count++] = prog2.vars[j];
+         }
+         levels[j] = level;
+     }
+
+     Bdd bdd;
+     int rc = -1;
+     if (bdd_init(&bdd, result->var_count) == 0) {
+         int f = bdd_from_program(&bdd, &prog, NULL);
+         int g = f;
+         if (f >= 0 && expr2) {
+             g = bdd_from_program(&bdd, &prog2, levels);
+             f = g < 0 ? -1 : bdd_apply(&bdd, BDD_XOR, f, g);
+         }
+         if (f >= 0 && !bdd.error && bdd_count(&bdd, f, &result->count) == 0) {
+             result->found = f != BDD_FALSE;
+             if (result->found) {
+                 result->model = bdd_satisfy(&bdd, f);
+                 // For equivalence, f differs from g exactly where g is 0
+                 result->value = expr2 ? !bdd_evaluate(&bdd, g, result->model) : 1;
+             }
+             result->counted = 1;
+             rc = 0;
+         }
+         result->nodes = bdd.count;
+         bdd_free(&bdd);
+     }
+     free_program(&prog);
+     if (expr2) {
+         free_program(&prog2);
+     }
+     return rc;
+ }
+
+ /* -------------------------------------------------------------------------
+  * check_equivalence:
+  *   Answers whether two expressions are equivalent, or with expr2 NULL
+  *   whether one is a tautology. Up to SWEEP_MAX_VARS variables, both are
+  *   compiled into one program and its truth table is swept on 'threads'
+  *   threads up to the first row at which they differ (or the expression is
+  *   false); that row is the counterexample, and the count is left unknown.
+  *   Wider expressions are compared with bdd_analyze, which also counts the
+  *   counterexamples.
+  *
+  *   Parameters:
+  *     expr    - The Boolean expression as a string.
+  *     expr2   - The expression to compare it with, or NULL for a tautology.
+  *     threads - Number of threads sweeping the truth table.
+  *     result  - Receives the variables of both expressions, whether a
+  *               counterexample exists, one laid out as a truth-table row,
+  *               and the value of expr there; as from bdd_analyze.
+  *
+  *   Returns:
+  *     0 on success, -1 if memory or the node limit ran out.
+  * ------------------------------------------------------------------------- */
+ int check_equivalence(const char *expr, const char *expr2, int threads, BddResult *result) {
+     const char *exprs[2] = { expr, expr2 };
+     Program prog;
+     memset(result, 0, sizeof(*result));
+     if (compile_expressions(exprs, expr2 ? 2 : 1, &prog) != 0) {
+         free_program(&prog);
+         return -1;
+     }
+     if (prog.var_count > SWEEP_MAX_VARS) {
+         free_program(&prog);
+         // A tautology is an expression equivalent to 1.
+         return bdd_analyze(expr, expr2 ? expr2 : "1", result);
+     }
+     optimize_program(&prog);
+ 
+     uint64_t row = 0;
+     int rc = find_counterexample(&prog, threads, &row);
+     if (rc >= 0) {
+         result->var_count = prog.var_count;
+         memcpy(result->vars, prog.vars, (size_t)prog.var_count);
+         result->found = rc;
+         result->model = row;
+     }
+     // A tautology fails where the expression is 0; two expressions differ
+     // where the first has either value.
+     Evaluator ev;
+     if (rc == 1 && expr2) {
+         if (evaluator_init(&ev, &prog) == 0) {
+             ev.values = row;
+             result->value = evaluator_run(&ev);
+             evaluator_free(&ev);
+         } else {
+             rc = -1;
+         }
+     }
+     free_program(&prog);
+     return rc < 0 ? -1 : 0;
+ }
@@ -0,0 +1,634 @@
+/*
+ * bench.c - Benchmarks for the Boolean Expression Solver
+ *
+ * This program times the main paths of the libboolsolve core library on
+ * randomly generated expressions, each separately, so that a change can be
+ * judged by its before and after numbers:
+ *
+ *   parse        recompile_expression (parsing and compiling), per expression
+ *   evaluate     evaluate_with_assignments, the one-shot parse-and-evaluate API
+ *   evaluator    evaluator_run on a compiled program, per assignment
+ *   kernel_interpreted, kernel_native
+ *                kernel_run on the same program, 64 assignments per run, with
+ *                the kernel kept interpreting or translated up front; the
+ *                time is per assignment
+ *   truth_table  parallel_truth_table with a callback that only counts
+ *   gray_table   gray_truth_table, in row order, with the same callback
+ *   format_text, format_csv, format_html, format_bin
+ *                the same table formatted by a TableWriter into /dev/null
+ *   separate_tables, multi_table
+ *                the tables of MULTI_EXPRESSIONS expressions that share the
+ *                table expression as a subterm, one parallel_truth_table
+ *                each or all in one over a program from compile_expressions;
+ *                the rows are counted once per expression
+ *   cgi          one server.cgi process per truth-table request, as a CGI
+ *                host would run it (skipped if the program is not found)
+ *
+ * Each benchmark repeats its work until it has run for at least the minimum
+ * time and prints one JSON object per line, with the time per operation in
+ * "ns_per_op" and, for the table paths, the rows per second in "rows_per_sec".
+ *
+ * Compilation:
+ *   make bench      (links against libboolsolve.a, see boolsolve.h)
+ *
+ * Usage:
+ *   ./bench [--vars N] [--depth N] [--mix AND:OR:NOT] [--expressions N]
+ *           [--threads N] [--min-time SECONDS] [--seed N] [--only NAME]
+ *           [--cgi PATH]
+ *     - Expressions are trees of the given depth (default 12) over at most
+ *       N variables (default 16) whose inner nodes are AND, OR and NOT in
+ *       the ratio of the mix (default 2:2:1). The parse and evaluate paths
+ *       use --expressions different ones (default 1000); the table paths use
+ *       one expression that contains every variable.
+ */
+
+ #define _GNU_SOURCE
+ #include "boolsolve.h"
+
+ #include <stdio.h>
+ #include <stdlib.h>
+ #include <string.h>
+ #include <time.h>
+ #include <fcntl.h>
+ #include <spawn.h>
+ #include <unistd.h>
+ #include <sys/wait.h>
+
+ /* Deepest expression tree the generator builds */
+ #define MAX_DEPTH 20
+
+ /* Expressions in the set of the multi_table path */
+ #define MULTI_EXPRESSIONS 16
+
+ /* -------------------------------------------------------------------------
+  * Expression Generator:
+  * A tree of the requested depth, built top-down. Each inner node is AND, OR
+  * or NOT with probabilities in the ratio of the mix; the leaves hold random
+  * variables, except that the first leaves of a table expression name every
+  * variable in turn so that its table has all 2^N rows.
+  * ------------------------------------------------------------------------- */
+ typedef struct {
+     uint64_t state;           /* xorshift64 state, never 0 */
+     int var_count;
+     int mix[3];               /* relative weights of AND, OR and NOT */
+     int next_var;             /* variables still to be named in order */
+     char *text;
+     size_t len;
+ } Generator;
+
+ static const char var_names[] = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz";
+
+ static uint64_t next_random(Generator *g) {
+     g->state ^= g->state << 13;
+     g->state ^= g->state >> 7;
+     g->state ^= g->state << 17;
+     return g->state;
+ }
+
+ static void emit(Generator *g, const char *s) {
+     size_t n = strlen(s);
+     memcpy(g->text + g->len, s, n);
+     g->len += n;
+ }
+
+ /* -------------------------------------------------------------------------
+  * generate_node:
+  *   Appends a subtree of the given depth to the generator's text.
+  * ------------------------------------------------------------------------- */
+ static void generate_node(Generator *g, int depth) {
+     if (depth == 0) {
+         int var = g->next_var < g->var_count ? g->next_var++
+                 : (int)(next_random(g) % (uint64_t)g->var_count);
+         g->text[g->len++] = var_names[var];
+         return;
+     }
+     int total = g->mix[0] + g->mix[1] + g->mix[2];
+     int pick = (int)(next_random(g) % (uint64_t)total);
+     if (pick >= g->mix[0] + g->mix[1]) {
+         emit(g, "!");
+         generate_node(g, depth - 1);
+         return;
+     }
+     emit(g, "(");
+     generate_node(g, depth - 1);
+     emit(g, pick < g->mix[0] ? " · " : " + ");
+     generate_node(g, depth - 1);
+     emit(g, ")");
+ }
+
+ /* -------------------------------------------------------------------------
+  * generate_expression:
+  *   Generates a random expression into a buffer the caller must free.
+  *
+  *   Parameters:
+  *     g         - The generator.
+  *     depth     - Depth of the expression tree.
+  *     every_var - Non-zero to use every variable at least once, which needs
+  *                 a tree with at least var_count leaves.
+  * ------------------------------------------------------------------------- */
+ static char *generate_expression(Generator *g, int depth, int every_var) {
+     // A binary node adds at most 6 bytes to its subtrees, "(" " · " ")".
+     g->text = malloc(((size_t)8 << depth) + 1);
+     if (!g->text) {
+         return NULL;
+     }
+     g->len = 0;
+     g->next_var = every_var ? 0 : g->var_count;
+     generate_node(g, depth);
+     g->text[g->len] = '\0';
+     return g->text;
+ }
+
+ /* -------------------------------------------------------------------------
+  * Timing and Reporting
+  * ------------------------------------------------------------------------- */
+ typedef struct {
+     int vars;
+     int depth;
+     int threads;
+     double min_time;
+     const char *only;
+ } BenchConfig;
+
+ static double now(void) {
+     struct timespec t;
+     clock_gettime(CLOCK_MONOTONIC, &t);
+     return t.tv_sec + t.tv_nsec * 1e-9;
+ }
+
+ static int selected(const BenchConfig *cfg, const char *name) {
+     return cfg->only == NULL || strcmp(cfg->only, name) == 0;
+ }
+
+ /* -------------------------------------------------------------------------
+  * report:
+  *   Prints one benchmark result as a JSON line.
+  *
+  *   Parameters:
+  *     name    - The benchmark.
+  *     vars    - Variables of the expression(s) measured.
+  *     ops     - Operations timed.
+  *     rows    - Truth-table rows produced, or 0 if the path has no rows.
+  *     seconds - Elapsed time.
+  * ------------------------------------------------------------------------- */
+ static void report(const BenchConfig *cfg, const char *name, int vars, uint64_t ops,
+                    uint64_t rows, double seconds) {
+     printf("{\"bench\":\"%s\",\"vars\":%d,\"depth\":%d,\"threads\":%d,\"ops\":%llu,"
+            "\"seconds\":%.6f,\"ns_per_op\":%.2f",
+            name, vars, cfg->depth, cfg->threads, (unsigned long long)ops, seconds,
+            seconds * 1e9 / (double)ops);
+     if (rows) {
+         printf(",\"rows\":%llu,\"rows_per_sec\":%.0f", (unsigned long long)rows,
+                (double)rows / seconds);
+     }
+     printf("}\n");
+     fflush(stdout);
+ }
+
+ /* -------------------------------------------------------------------------
+  * Expression Paths
+  * ------------------------------------------------------------------------- */
+
+ /* -------------------------------------------------------------------------
+  * bench_expressions:
+  *   Times parsing, one-shot evaluation and compiled evaluation over a set
+  *   of expressions.
+  *
+  *   Returns:
+  *     0 on success, 1 if memory ran out.
+  * ------------------------------------------------------------------------- */
+ static int bench_expressions(const BenchConfig *cfg, char **exprs, int count) {
+     Program prog;
+     if (compile_expression("", &prog) != 0) {
+         return 1;
+     }
+     volatile int sink = 0;
+
+     if (selected(cfg, "parse")) {
+         uint64_t ops = 0;
+         double start = now(), elapsed;
+         do {
+             for (int i = 0; i < count; i++) {
+                 if (recompile_expression(exprs[i], &prog) != 0) {
+                     free_program(&prog);
+                     return 1;
+                 }
+             }
+             ops += count;
+         } while ((elapsed = now() - start) < cfg->min_time);
+         report(cfg, "parse", cfg->vars, ops, 0, elapsed);
+     }
+
+     if (selected(cfg, "evaluate")) {
+         uint64_t ops = 0;
+         double start = now(), elapsed;
+         do {
+             for (int i = 0; i < count; i++) {
+                 int result;
+                 evaluate_with_assignments(exprs[i], NULL, &result);
+                 sink += result;
+             }
+             ops += count;
+         } while ((elapsed = now() - start) < cfg->min_time);
+         report(cfg, "evaluate", cfg->vars, ops, 0, elapsed);
+     }
+
+     if (selected(cfg, "evaluator")) {
+         // One compiled program, run on a stream of different assignments.
+         Evaluator ev;
+         if (recompile_expression(exprs[0], &prog) != 0 || evaluator_init(&ev, &prog) != 0) {
+             free_program(&prog);
+             return 1;
+         }
+         uint64_t ops = 0, values = 0x9E3779B97F4A7C15ULL;
+         double start = now(), elapsed;
+         do {
+             for (int i = 0; i < 1024; i++) {
+                 values = values * 6364136223846793005ULL + 1442695040888963407ULL;
+                 ev.values = values;
+                 sink += evaluator_run(&ev);
+             }
+             ops += 1024;
+         } while ((elapsed = now() - start) < cfg->min_time);
+         report(cfg, "evaluator", prog.var_count, ops, 0, elapsed);
+         evaluator_free(&ev);
+     }
+
+     for (int native = 0; native < 2; native++) {
+         const char *name = native ? "kernel_native" : "kernel_interpreted";
+         if (!selected(cfg, name)) {
+             continue;
+         }
+         Kernel k;
+         if (recompile_expression(exprs[0], &prog) != 0 || kernel_init(&k, &prog) != 0) {
+             free_program(&prog);
+             return 1;
+         }
+         k.budget = 0;
+         if (native && kernel_compile(&k) != 0) {
+             fprintf(stderr, "%s: no native code on this platform\n", name);
+             kernel_free(&k);
+             continue;
+         }
+         uint64_t slices[MAX_VARS], ops = 0, values = 0x9E3779B97F4A7C15ULL;
+         double start = now(), elapsed;
+         do {
+             for (int i = 0; i < 1024; i++) {
+                 for (int j = 0; j < prog.var_count; j++) {
+                     values = values * 6364136223846793005ULL + 1442695040888963407ULL;
+                     slices[j] = values;
+                 }
+                 sink += (int)(kernel_run(&k, slices) & 1);
+             }
+             ops += 1024 * 64;
+         } while ((elapsed = now() - start) < cfg->min_time);
+         report(cfg, name, prog.var_count, ops, 0, elapsed);
+         kernel_free(&k);
+     }
+     free_program(&prog);
+     return 0;
+ }
+
+ /* -------------------------------------------------------------------------
+  * Truth-Table Paths
+  * ------------------------------------------------------------------------- */
+
+ /* ChunkCallback that counts the true rows, so no result goes unused */
+ static void count_rows(void *ctx, uint64_t first, uint64_t count, const uint64_t *results) {
+     uint64_t *ones = ctx;
+     (void)first;
+     for (uint64_t w = 0; w * 64 < count; w++) {
+         uint64_t word = results[w];
+         if (count - w * 64 < 64) {
+             word &= (1ULL << (count - w * 64)) - 1;
+         }
+         *ones += (uint64_t)__builtin_popcountll(word);
+     }
+ }
+
+ /* -------------------------------------------------------------------------
+  * bench_table:
+  *   Times the evaluation of one expression's truth table, then its output
+  *   in every format. The table's number of variables is stored in *vars.
+  *
+  *   Returns:
+  *     0 on success, 1 on failure.
+  * ------------------------------------------------------------------------- */
+ static int bench_table(const BenchConfig *cfg, const char *expr, int *vars) {
+     static const struct { const char *name; int format; } formats[] = {
+         { "format_text", FORMAT_TEXT }, { "format_csv", FORMAT_CSV },
+         { "format_html", FORMAT_HTML }, { "format_bin", FORMAT_BINARY },
+     };
+     Program prog;
+     if (compile_expression(expr, &prog) != 0) {
+         return 1;
+     }
+     optimize_program(&prog);
+     uint64_t rows = 1ULL << prog.var_count;
+     *vars = prog.var_count;
+
+     if (selected(cfg, "truth_table")) {
+         uint64_t ops = 0, ones = 0;
+         double start = now(), elapsed;
+         do {
+             if (parallel_truth_table(&prog, cfg->threads, count_rows, &ones) != 0) {
+                 free_program(&prog);
+                 return 1;
+             }
+             ops++;
+         } while ((elapsed = now() - start) < cfg->min_time);
+         report(cfg, "truth_table", prog.var_count, ops, ops * rows, elapsed);
+     }
+     if (selected(cfg, "gray_table")) {
+         uint64_t ops = 0, ones = 0;
+         double start = now(), elapsed;
+         do {
+             if (gray_truth_table(&prog, 0, count_rows, &ones) != 0) {
+                 free_program(&prog);
+                 return 1;
+             }
+             ops++;
+         } while ((elapsed = now() - start) < cfg->min_time);
+         report(cfg, "gray_table", prog.var_count, ops, ops * rows, elapsed);
+     }
+
+     int null_fd = open("/dev/null", O_WRONLY);
+     if (null_fd < 0) {
+         perror("/dev/null");
+         free_program(&prog);
+         return 1;
+     }
+     for (size_t f = 0; f < sizeof(formats) / sizeof(formats[0]); f++) {
+         if (!selected(cfg, formats[f].name)) {
+             continue;
+         }
+         uint64_t ops = 0;
+         double start = now(), elapsed;
+         do {
+             TableWriter writer;
+             if (writer_init(&writer, formats[f].format, &prog, null_fd, NULL) != 0
+                 || parallel_truth_table(&prog, cfg->threads, writer_rows, &writer) != 0
+                 || writer_finish(&writer) != 0) {
+                 close(null_fd);
+                 free_program(&prog);
+                 return 1;
+             }
+             ops++;
+         } while ((elapsed = now() - start) < cfg->min_time);
+         report(cfg, formats[f].name, prog.var_count, ops, ops * rows, elapsed);
+     }
+     close(null_fd);
+     free_program(&prog);
+     return 0;
+ }
+
+ /* ChunkCallback that counts the true rows of every output of a program */
+ typedef struct {
+     int outputs;
+     uint64_t ones;
+ } OutputCount;
+
+ static void count_outputs(void *ctx, uint64_t first, uint64_t count, const uint64_t *results) {
+     OutputCount *c = ctx;
+     for (int o = 0; o < c->outputs; o++) {
+         count_rows(&c->ones, first, count, results + o * CHUNK_WORDS);
+     }
+ }
+
+ /* -------------------------------------------------------------------------
+  * bench_multi:
+  *   Times the truth tables of a set of expressions built from the table
+  *   expression and the first of 'exprs', separately and in one sweep.
+  *
+  *   Returns:
+  *     0 on success, 1 on failure.
+  * ------------------------------------------------------------------------- */
+ static int bench_multi(const BenchConfig *cfg, const char *table_expr, char **exprs, int count) {
+     if (!selected(cfg, "separate_tables") && !selected(cfg, "multi_table")) {
+         return 0;
+     }
+     char *set[MULTI_EXPRESSIONS];
+     Program progs[MULTI_EXPRESSIONS];
+     Program multi;
+     int n = 0, rc = 1;
+     for (; n < MULTI_EXPRESSIONS; n++) {
+         const char *other = exprs[n % count];
+         set[n] = malloc(strlen(table_expr) + strlen(other) + 8);
+         if (!set[n]) {
+             break;
+         }
+         sprintf(set[n], "(%s)%s(%s)", table_expr, n % 2 ? "+" : "·", other);
+         if (compile_expression(set[n], &progs[n]) != 0) {
+             free(set[n]);
+             break;
+         }
+         optimize_program(&progs[n]);
+     }
+     if (n == MULTI_EXPRESSIONS
+         && compile_expressions((const char *const *)set, n, &multi) == 0) {
+         optimize_program(&multi);
+         uint64_t rows = (1ULL << multi.var_count) * MULTI_EXPRESSIONS;
+         rc = 0;
+         if (selected(cfg, "separate_tables")) {
+             uint64_t ops = 0, ones = 0;
+             double start = now(), elapsed;
+             do {
+                 for (int i = 0; i < n && rc == 0; i++) {
+                     rc = parallel_truth_table(&progs[i], cfg->threads, count_rows, &ones) != 0;
+                 }
+                 ops++;
+             } while (rc == 0 && (elapsed = now() - start) < cfg->min_time);
+             if (rc == 0) {
+                 report(cfg, "separate_tables", multi.var_count, ops, ops * rows, elapsed);
+             }
+         }
+         if (rc == 0 && selected(cfg, "multi_table")) {
+             OutputCount ones = { multi.outputs, 0 };
+             uint64_t ops = 0;
+             double start = now(), elapsed;
+             do {
+                 rc = parallel_truth_table(&multi, cfg->threads, count_outputs, &ones) != 0;
+                 ops++;
+             } while (rc == 0 && (elapsed = now() - start) < cfg->min_time);
+             if (rc == 0) {
+                 report(cfg, "multi_table", multi.var_count, ops, ops * rows, elapsed);
+             }
+         }
+         free_program(&multi);
+     }
+     for (int i = 0; i < n; i++) {
+         free_program(&progs[i]);
+         free(set[i]);
+     }
+     return rc;
+ }
+
+ /* -------------------------------------------------------------------------
+  * url_encode:
+  *   Percent-encodes every byte of 'text' other than letters and digits.
+  *   The caller must free the result.
+  * ------------------------------------------------------------------------- */
+ static char *url_encode(const char *text) {
+     char *out = malloc(3 * strlen(text) + 1), *p = out;
+     if (!out) {
+         return NULL;
+     }
+     for (; *text; text++) {
+         unsigned char ch = (unsigned char)*text;
+         if ((ch >= 'A' && ch <= 'Z') || (ch >= 'a' && ch <= 'z') || (ch >= '0' && ch <= '9')) {
+             *p++ = (char)ch;
+         } else {
+             p += sprintf(p, "%%%02X", ch);
+         }
+     }
+     *p = '\0';
+     return out;
+ }
+
+ /* -------------------------------------------------------------------------
+  * bench_cgi:
+  *   Times whole CGI requests for the truth table of one expression: a new
+  *   server.cgi process per request, with its output discarded.
+  *
+  *   Returns:
+  *     0 on success or if the program is missing, 1 on failure.
+  * ------------------------------------------------------------------------- */
+ static int bench_cgi(const BenchConfig *cfg, const char *program, const char *expr,
+                      int vars) {
+     if (!selected(cfg, "cgi") || access(program, X_OK) != 0) {
+         return 0;
+     }
+     char *encoded = url_encode(expr);
+     char *query = encoded ? malloc(strlen(encoded) + 32) : NULL;
+     if (!query) {
+         free(encoded);
+         return 1;
+     }
+     sprintf(query, "QUERY_STRING=mode=tt&expr=%s", encoded);
+     free(encoded);
+     char threads[32];
+     snprintf(threads, sizeof(threads), "SOLVER_THREADS=%d", cfg->threads);
+     char *envp[] = { query, threads, "REQUEST_METHOD=GET", NULL };
+     char *argv[] = { (char *)program, NULL };
+
+     posix_spawn_file_actions_t actions;
+     posix_spawn_file_actions_init(&actions);
+     posix_spawn_file_actions_addopen(&actions, STDOUT_FILENO, "/dev/null", O_WRONLY, 0);
+
+     int rc = 0;
+     uint64_t ops = 0;
+     double start = now(), elapsed;
+     do {
+         pid_t pid;
+         int status;
+         if (posix_spawn(&pid, program, &actions, NULL, argv, envp) != 0
+             || waitpid(pid, &status, 0) != pid || !WIFEXITED(status)) {
+             fprintf(stderr, "Error: Could not run %s.\n", program);
+             rc = 1;
+             break;
+         }
+         ops++;
+     } while ((elapsed = now() - start) < cfg->min_time);
+     if (rc == 0) {
+         report(cfg, "cgi", vars, ops, ops << vars, elapsed);
+     }
+     posix_spawn_file_actions_destroy(&actions);
+     free(query);
+     return rc;
+ }
+
+ /* -------------------------------------------------------------------------
+  * print_usage:
+  *   Prints the command-line options.
+  * ------------------------------------------------------------------------- */
+ static void print_usage(const char *progname) {
+     fprintf(stderr, "Usage: %s [--vars N] [--depth N] [--mix AND:OR:NOT] [--expressions N]\n"
+                     "       [--threads N] [--min-time SECONDS] [--seed N] [--only NAME]\n"
+                     "       [--cgi PATH]\n", progname);
+ }
+
+ int main(int argc, char *argv[]) {
+     BenchConfig cfg = { 16, 12, 1, 0.5, NULL };
+     Generator g = { .state = 88172645463325252ULL, .mix = { 2, 2, 1 } };
+     int expressions = 1000;
+     const char *cgi = "./server.cgi";
+
+     for (int i = 1; i < argc; i++) {
+         if (strcmp(argv[i], "--vars") == 0 && i + 1 < argc) {
+             cfg.vars = atoi(argv[++i]);
+         } else if (strcmp(argv[i], "--depth") == 0 && i + 1 < argc) {
+             cfg.depth = atoi(argv[++i]);
+         } else if (strcmp(argv[i], "--mix") == 0 && i + 1 < argc) {
+             if (sscanf(argv[++i], "%d:%d:%d", &g.mix[0], &g.mix[1], &g.mix[2]) != 3) {
+                 print_usage(argv[0]);
+                 return 1;
+             }
+         } else if (strcmp(argv[i], "--expressions") == 0 && i + 1 < argc) {
+             expressions = atoi(argv[++i]);
+         } else if (strcmp(argv[i], "--threads") == 0 && i + 1 < argc) {
+             cfg.threads = atoi(argv[++i]);
+         } else if (strcmp(argv[i], "--min-time") == 0 && i + 1 < argc) {
+             cfg.min_time = atof(argv[++i]);
+         } else if (strcmp(argv[i], "--seed") == 0 && i + 1 < argc) {
+             g.state = strtoull(argv[++i], NULL, 10) | 1;
+         } else if (strcmp(argv[i], "--only") == 0 && i + 1 < argc) {
+             cfg.only = argv[++i];
+         } else if (strcmp(argv[i], "--cgi") == 0 && i + 1 < argc) {
+             cgi = argv[++i];
+         } else {
+             print_usage(argv[0]);
+             return 1;
+         }
+     }
+     int max_vars = (int)sizeof(var_names) - 1;
+     if (cfg.vars < 1 || cfg.vars > max_vars || cfg.depth < 1 || cfg.depth > MAX_DEPTH
+         || expressions < 1 || g.mix[0] < 0 || g.mix[1] < 0 || g.mix[2] < 0
+         || g.mix[0] + g.mix[1] + g.mix[2] == 0) {
+         fprintf(stderr, "Error: Need 1-%d variables, a depth of 1-%d, at least one\n"
+                         "expression and a mix with a positive weight.\n", max_vars, MAX_DEPTH);
+         return 1;
+     }
+     g.var_count = cfg.vars;
+
+     char **exprs = calloc(expressions, sizeof(char *));
+     for (int i = 0; exprs && i < expressions; i++) {
+         exprs[i] = generate_expression(&g, cfg.depth, 0);
+         if (!exprs[i]) {
+             fprintf(stderr, "Error: Out of memory.\n");
+             return 1;
+         }
+     }
+     // The table expression needs a leaf per variable; NOT nodes may still
+     // leave some out.
+     int table_depth = cfg.depth;
+     while ((1 << table_depth) < cfg.vars) {
+         table_depth++;
+     }
+     char *table_expr = exprs ? generate_expression(&g, table_depth, 1) : NULL;
+     if (!table_expr) {
+         fprintf(stderr, "Error: Out of memory.\n");
+         return 1;
+     }
+
+     int rc = bench_expressions(&cfg, exprs, expressions);
+     if (rc == 0 && cfg.vars <= 30) {
+         int table_vars;
+         rc = bench_table(&cfg, table_expr, &table_vars);
+         if (rc == 0) {
+             rc = bench_multi(&cfg, table_expr, exprs, expressions);
+         }
+         if (rc == 0) {
+             rc = bench_cgi(&cfg, cgi, table_expr, table_vars);
+         }
+     }
+     if (rc != 0) {
+         fprintf(stderr, "Error: Benchmark failed.\n");
+     }
+
+     for (int i = 0; i < expressions; i++) {
+         free(exprs[i]);
+     }
+     free(exprs);
+     free(table_expr);
+     return rc;
+ }
\ No newline at end of file
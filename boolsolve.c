@@ -0,0 +1,2851 @@
+/*
+ * boolsolve.c - Core library of the Boolean Expression Solver
+ *
+ * Implements the API declared in boolsolve.h: a non-recursive compiler
+ * that builds a hash-consed expression DAG and emits postfix bytecode from
+ * it, an optimizer over the same DAG, a scalar evaluator for a single
+ * assignment, a kernel for 64 assignments at once that is translated to
+ * x86-64 machine code when it runs long enough, and a bitsliced,
+ * multi-threaded truth-table engine with a buffered table writer. Both the solver and server.cgi front ends link
+ * against it as libboolsolve.a.
+ */
+
+ #include "boolsolve.h"
+
+ #include <stdlib.h>
+ #include <string.h>
+ #include <ctype.h>
+ #include <errno.h>
+ #include <limits.h>
+ #include <unistd.h>
+ #include <pthread.h>
+ #include <sys/mman.h>
+ 
+ /* -------------------------------------------------------------------------
+  * Tokens:
+  * An expression is first split into a stream of Tokens in a single pass
+  * over its bytes; whitespace is dropped, the UTF-8 sequence for '·' and its
+  * ASCII aliases '&' and '*' all become TOK_AND, and every variable is
+  * resolved to its slot.
+  * ------------------------------------------------------------------------- */
+ enum {
+     TOK_END,      /* end of the expression */
+     TOK_CONST,    /* digit; arg is its value */
+     TOK_VAR,      /* variable; arg is its slot */
+     TOK_NOT,      /* '!' */
+     TOK_AND,      /* '·', '&' or '*' */
+     TOK_OR,       /* '+' */
+     TOK_LPAREN,   /* '(' */
+     TOK_RPAREN,   /* ')' */
+     TOK_UNKNOWN   /* any other character */
+ };
+ 
+ typedef struct {
+     unsigned char type;
+     unsigned char arg;
+ } Token;
+ 
+ /* Expressions shorter than this are tokenized without allocating. */
+ #define SMALL_TOKENS 256
+ 
+ /* -------------------------------------------------------------------------
+  * Expression DAG:
+  * The parser does not emit code directly. It builds a hash-consed DAG in
+  * one contiguous node array: every (op, arg, a, b) combination exists at
+  * most once, and the operands of '·' and '+' are stored in index order, so
+  * repeated subterms such as "A·B" and "B·A" become one node. Operands are
+  * always created before the nodes using them, so index order is also a
+  * topological order. The program is then emitted from the DAG with every
+  * shared subterm computed once, kept in a temporary by OP_STORE and reused
+  * by OP_LOAD. The optimizer works on the same DAG, where two subterms are
+  * equal exactly when their indices are.
+  * ------------------------------------------------------------------------- */
+ typedef struct {
+     unsigned char op;         /* OP_CONST, OP_VAR, OP_NOT, OP_AND or OP_OR */
+     unsigned char arg;        /* value of OP_CONST, assignment bit of OP_VAR */
+     int a, b;                 /* operands, -1 if unused; a < b for '·', '+' */
+     unsigned hash;
+     int uses;                 /* references from reachable nodes */
+     int need;                 /* stack entries needed to evaluate the node */
+     int slot;                 /* temporary holding the value, -1 if none */
+     int simplified;           /* optimized equivalent, -1 if not known yet */
+ } DagNode;
+ 
+ struct Dag {
+     DagNode *nodes;
+     int count;
+     int capacity;
+     int *table;               /* node indices by hash, -1 when empty */
+     int table_size;           /* a power of two, at least twice capacity */
+     int *list;                /* operand lists and work stacks */
+     int list_len;
+     int list_capacity;
+     int *free_slots;          /* temporaries released during emission */
+     int free_capacity;
+     int *frames;              /* work stack of simplify_node */
+     int frame_capacity;
+     int *pending;             /* work stack of gather_operands */
+     int pending_capacity;
+     int error;                /* set when an allocation failed */
+ };
+ 
+ typedef struct {
+     const Token *t;           /* next token of the expression */
+     Dag *dag;                 /* DAG receiving the parsed nodes */
+     int *stack;               /* two ints per token, see parse_expression */
+     int var_count;
+ } Parser;
+ 
+ /* On x86-64 the kernel is built for AVX-512, AVX2 and baseline SSE2, and
+  * the best one for the running CPU is selected at load time. */
+ #if defined(__x86_64__) && defined(__linux__) && defined(__GNUC__)
+ #define BITSLICE_KERNEL __attribute__((target_clones("avx512f", "avx2", "default")))
+ #else
+ #define BITSLICE_KERNEL
+ #endif
+ 
+ /* Kernels are translated to machine code only on x86-64, see Kernel. */
+ #if defined(__x86_64__) && defined(__linux__)
+ #define KERNEL_JIT
+ #endif
+ 
+ /* Each worker of parallel_truth_table is handed CHUNKS_PER_THREAD chunks
+  * of every window. */
+ #define CHUNKS_PER_THREAD 8
+ 
+ typedef struct {
+     pthread_mutex_t lock;
+     uint64_t next;            /* next chunk this worker will take */
+     uint64_t end;             /* one past the last chunk still in the range */
+ } WorkRange;
+ 
+ typedef struct {
+     const Program *prog;
+     uint64_t end_row;         /* one past the last row to evaluate */
+     int threads;
+     WorkRange *ranges;        /* one per worker */
+     pthread_mutex_t lock;     /* guards the fields below */
+     pthread_cond_t work_ready;
+     pthread_cond_t work_done;
+     uint64_t generation;      /* bumped whenever a window is published */
+     uint64_t window_first;    /* first chunk index of the current window */
+     uint64_t *window_results; /* CHUNK_WORDS words per output and chunk */
+     int pending;              /* workers still busy with the current window */
+     int stop;
+ } TablePool;
+ 
+ /* Patterns of the six lowest row-index bits within one 64-row word */
+ static const uint64_t low_patterns[6] = {
+     0xAAAAAAAAAAAAAAAAULL, 0xCCCCCCCCCCCCCCCCULL, 0xF0F0F0F0F0F0F0F0ULL,
+     0xFF00FF00FF00FF00ULL, 0xFFFF0000FFFF0000ULL, 0xFFFFFFFF00000000ULL
+ };
+ 
+ /* -------------------------------------------------------------------------
+  * Internal Function Prototypes
+  * ------------------------------------------------------------------------- */
+ static void skip_whitespace(const char **s);
+ static int parse_expression(Parser *ps);
+ static int simplify_node(Dag *dag, int n);
+ static int simplify_list(Dag *dag, unsigned char op, int base);
+ 
+ /* -------------------------------------------------------------------------
+  * skip_whitespace:
+  *   Advances the pointer past any whitespace characters.
+  * ------------------------------------------------------------------------- */
+ static void skip_whitespace(const char **s) {
+     while (**s && isspace(**s)) {
+         (*s)++;
+     }
+ }
+ 
+ /* -------------------------------------------------------------------------
+  * grow_array:
+  *   Reallocates a growable array to hold at least 'needed' elements of
+  *   'size' bytes, doubling its capacity.
+  *
+  *   Returns:
+  *     The new array, or NULL (leaving the old one intact) if memory could
+  *     not be allocated.
+  * ------------------------------------------------------------------------- */
+ static void *grow_array(void *array, int *capacity, int needed, size_t size) {
+     int n = *capacity > 0 ? *capacity : 64;
+     while (n < needed) {
+         n *= 2;
+     }
+     void *grown = realloc(array, (size_t)n * size);
+     if (grown) {
+         *capacity = n;
+     }
+     return grown;
+ }
+ 
+ /* -------------------------------------------------------------------------
+  * hash_node:
+  *   Hashes the fields that identify a DAG node.
+  * ------------------------------------------------------------------------- */
+ static unsigned hash_node(unsigned char op, unsigned char arg, int a, int b) {
+     unsigned h = ((unsigned)op << 8 | arg) * 0x9E3779B1u;
+     h = (h ^ (unsigned)a) * 0x85EBCA6Bu;
+     h = (h ^ (unsigned)b) * 0xC2B2AE35u;
+     return h ^ (h >> 16);
+ }
+ 
+ /* -------------------------------------------------------------------------
+  * dag_reserve:
+  *   Makes room for 'needed' nodes, rebuilding the hash table whenever it
+  *   would become more than half full.
+  *
+  *   Returns:
+  *     0 on success, -1 (with the error flag set) if memory ran out.
+  * ------------------------------------------------------------------------- */
+ static int dag_reserve(Dag *dag, int needed) {
+     if (needed > dag->capacity) {
+         DagNode *nodes = grow_array(dag->nodes, &dag->capacity, needed, sizeof(DagNode));
+         if (!nodes) {
+             dag->error = 1;
+             return -1;
+         }
+         dag->nodes = nodes;
+     }
+     if (dag->table_size >= 2 * dag->capacity) {
+         return 0;
+     }
+     int size = dag->table_size > 0 ? dag->table_size : 128;
+     while (size < 2 * dag->capacity) {
+         size *= 2;
+     }
+     int *table = malloc((size_t)size * sizeof(int));
+     if (!table) {
+         dag->error = 1;
+         return -1;
+     }
+     memset(table, -1, (size_t)size * sizeof(int));
+     for (int n = 0; n < dag->count; n++) {
+         unsigned i = dag->nodes[n].hash & (unsigned)(size - 1);
+         while (table[i] >= 0) {
+             i = (i + 1) & (unsigned)(size - 1);
+         }
+         table[i] = n;
+     }
+     free(dag->table);
+     dag->table = table;
+     dag->table_size = size;
+     return 0;
+ }
+ 
+ /* -------------------------------------------------------------------------
+  * dag_reset:
+  *   Empties a DAG for reuse and makes room for 'expected' nodes. Only the
+  *   table entries of the previous nodes are cleared, so reusing a large
+  *   DAG for a short expression stays cheap.
+  *
+  *   Returns:
+  *     0 on success, -1 if memory could not be allocated.
+  * ------------------------------------------------------------------------- */
+ static int dag_reset(Dag *dag, int expected) {
+     unsigned mask = (unsigned)dag->table_size - 1;
+     for (int n = 0; n < dag->count; n++) {
+         unsigned i = dag->nodes[n].hash & mask;
+         while (dag->table[i] != n) {
+             i = (i + 1) & mask;
+         }
+         dag->table[i] = -1;
+     }
+     dag->count = 0;
+     dag->list_len = 0;
+     dag->error = 0;
+     return dag_reserve(dag, expected);
+ }
+ 
+ /* -------------------------------------------------------------------------
+  * dag_free:
+  *   Releases a DAG and everything it owns.
+  * ------------------------------------------------------------------------- */
+ static void dag_free(Dag *dag) {
+     if (dag) {
+         free(dag->nodes);
+         free(dag->table);
+         free(dag->list);
+         free(dag->free_slots);
+         free(dag->frames);
+         free(dag->pending);
+         free(dag);
+     }
+ }
+ 
+ /* -------------------------------------------------------------------------
+  * dag_node:
+  *   Returns the node (op, arg, a, b), creating it only if no equal node
+  *   exists yet. The operands of '·' and '+' are put in index order first.
+  *
+  *   Returns:
+  *     The index of the node. If memory runs out, the error flag is set and
+  *     node 0 is returned, so callers can finish before the DAG is discarded.
+  * ------------------------------------------------------------------------- */
+ static int dag_node(Dag *dag, unsigned char op, unsigned char arg, int a, int b) {
+     if ((op == OP_AND || op == OP_OR) && a > b) {
+         int t = a;
+         a = b;
+         b = t;
+     }
+     unsigned hash = hash_node(op, arg, a, b);
+     unsigned mask = (unsigned)dag->table_size - 1;
+     unsigned i = hash & mask;
+     for (int n; (n = dag->table[i]) >= 0; i = (i + 1) & mask) {
+         const DagNode *d = &dag->nodes[n];
+         if (d->hash == hash && d->op == op && d->arg == arg && d->a == a && d->b == b) {
+             return n;
+         }
+     }
+ 
+     if (dag->count == dag->capacity) {
+         if (dag_reserve(dag, dag->count + 1) != 0) {
+             return 0;
+         }
+         mask = (unsigned)dag->table_size - 1;
+         for (i = hash & mask; dag->table[i] >= 0; i = (i + 1) & mask) {
+         }
+     }
+     // Stack entries needed to evaluate the node (Sethi-Ullman number).
+     int need = 1;
+     if (op == OP_NOT) {
+         need = dag->nodes[a].need;
+     } else if (op == OP_AND || op == OP_OR) {
+         int l = dag->nodes[a].need, r = dag->nodes[b].need;
+         need = l == r ? l + 1 : (l > r ? l : r);
+     }
+     DagNode *d = &dag->nodes[dag->count];
+     d->need = need;
+     d->op = op;
+     d->arg = arg;
+     d->a = a;
+     d->b = b;
+     d->hash = hash;
+     d->uses = 0;
+     d->slot = -1;
+     d->simplified = -1;
+     dag->table[i] = dag->count;
+     return dag->count++;
+ }
+ 
+ /* -------------------------------------------------------------------------
+  * emit_program:
+  *   Emits the subgraph of the DAG reachable from the 'count' nodes in
+  *   'roots' as the postfix code of prog, which leaves the value of root o
+  *   in stack entry o. A node used more than once, by one root or by
+  *   several, is computed on its first use and kept with OP_STORE; later
+  *   uses are OP_LOADs, and its temporary is recycled after the last one.
+  *   Constants and variables are cheaper to push again than to load, so
+  *   they are never stored. The operand that needs the deeper stack is
+  *   evaluated first to keep the stack shallow.
+  *
+  *   Returns:
+  *     0 on success, -1 if memory could not be allocated, in which case the
+  *     program is left unchanged.
+  * ------------------------------------------------------------------------- */
+ static int emit_program(Dag *dag, const int *roots, int count, Program *prog) {
+     DagNode *nodes = dag->nodes;
+     int last = 0;
+     for (int i = 0; i < count; i++) {
+         if (roots[i] > last) {
+             last = roots[i];
+         }
+     }
+ 
+     // Count the references to every reachable node, each root counting
+     // as one. Operands have lower indices than their users, so a single
+     // backward pass suffices.
+     for (int n = 0; n <= last; n++) {
+         nodes[n].uses = 0;
+         nodes[n].slot = -1;
+     }
+     for (int i = 0; i < count; i++) {
+         nodes[roots[i]].uses++;
+     }
+     size_t length = 0;
+     int shared = 0;
+     for (int n = last; n >= 0; n--) {
+         DagNode *d = &nodes[n];
+         if (d->uses == 0) {
+             continue;
+         }
+         if (d->op == OP_CONST || d->op == OP_VAR) {
+             length += (size_t)d->uses;
+             continue;
+         }
+         // The operation, plus one OP_STORE and an OP_LOAD per extra use.
+         length += d->uses > 1 ? (size_t)d->uses + 1 : 1;
+         shared += d->uses > 1;
+         nodes[d->a].uses++;
+         if (d->b >= 0) {
+             nodes[d->b].uses++;
+         }
+     }
+ 
+     // Reserve everything before touching the program.
+     if (2 * (last + 1) > dag->list_capacity) {
+         int *list = grow_array(dag->list, &dag->list_capacity, 2 * (last + 1), sizeof(int));
+         if (!list) {
+             return -1;
+         }
+         dag->list = list;
+     }
+     if (shared > dag->free_capacity) {
+         int *slots = grow_array(dag->free_slots, &dag->free_capacity, shared, sizeof(int));
+         if (!slots) {
+             return -1;
+         }
+         dag->free_slots = slots;
+     }
+     if (length > (size_t)prog->capacity) {
+         if (length > INT_MAX) {
+             return -1;
+         }
+         Instr *code = realloc(prog->code, length * sizeof(Instr));
+         if (!code) {
+             return -1;
+         }
+         prog->code = code;
+         prog->capacity = (int)length;
+     }
+ 
+     // Depth-first walk from each root in turn, with an explicit stack of
+     // (node, operands visited) frames. Leaves and stored values are
+     // emitted without a frame.
+     Instr *code = prog->code;
+     int *frames = dag->list;
+     int top = 0, next = roots[0], emitted = 1, free_count = 0;
+     int out = 0, depth = 0, max_depth = 0, slot_count = 0;
+     for (;;) {
+         if (next >= 0) {
+             DagNode *d = &nodes[next];
+             next = -1;
+             if (d->slot >= 0) {
+                 code[out].op = OP_LOAD;
+                 code[out].arg = (uint32_t)d->slot;
+                 if (--d->uses == 0) {
+                     dag->free_slots[free_count++] = d->slot;
+                 }
+             } else if (d->op == OP_CONST || d->op == OP_VAR) {
+                 code[out].op = d->op;
+                 code[out].arg = d->arg;
+             } else {
+                 frames[2 * top] = (int)(d - nodes);
+                 frames[2 * top + 1] = 0;
+                 top++;
+                 continue;
+             }
+             out++;
+             if (++depth > max_depth) {
+                 max_depth = depth;
+             }
+         }
+         if (top == 0) {
+             if (emitted == count) {
+                 break;
+             }
+             next = roots[emitted++];
+             continue;
+         }
+ 
+         int *f = &frames[2 * (top - 1)];
+         DagNode *d = &nodes[f[0]];
+         int arity = d->op == OP_NOT ? 1 : 2;
+         if (f[1] < arity) {
+             int first = d->a, second = d->b;
+             if (arity == 2 && nodes[second].need > nodes[first].need) {
+                 first = d->b;
+                 second = d->a;
+             }
+             next = f[1]++ == 0 ? first : second;
+             continue;
+         }
+         top--;
+         code[out].op = d->op;
+         code[out].arg = 0;
+         out++;
+         if (arity == 2) {
+             depth--;
+         }
+         if (d->uses > 1) {
+             d->slot = free_count > 0 ? dag->free_slots[--free_count] : slot_count++;
+             d->uses--;
+             code[out].op = OP_STORE;
+             code[out].arg = (uint32_t)d->slot;
+             out++;
+         }
+     }
+ 
+     prog->length = out;
+     prog->max_depth = max_depth;
+     prog->slot_count = slot_count;
+     prog->outputs = count;
+     return 0;
+ }
+ 
+ /* -------------------------------------------------------------------------
+  * tokenize:
+  *   Splits an expression into tokens and records its variables in order of
+  *   first appearance, after those prog already has. 'tokens' must have
+  *   room for strlen(expr) + 1 entries; the stream is terminated by TOK_END.
+  *
+  *   Returns:
+  *     The number of tokens, not counting TOK_END.
+  * ------------------------------------------------------------------------- */
+ static int tokenize(const char *expr, Token *tokens, Program *prog) {
+     const unsigned char *p = (const unsigned char *)expr;
+     signed char slot_of[128];
+     memset(slot_of, -1, sizeof(slot_of));
+     for (int j = 0; j < prog->var_count; j++) {
+         slot_of[(unsigned char)prog->vars[j]] = (signed char)j;
+     }
+     int n = 0;
+ 
+     while (*p) {
+         unsigned char c = *p++;
+         if (isspace(c)) {
+             continue;
+         }
+         Token *t = &tokens[n++];
+         t->arg = 0;
+         if (c == '+') {
+             t->type = TOK_OR;
+         } else if (c == '&' || c == '*') {
+             t->type = TOK_AND;
+         } else if (c == 0xC2 && *p == 0xB7) {
+             // '·' is the two-byte UTF-8 sequence C2 B7.
+             t->type = TOK_AND;
+             p++;
+         } else if (c == '!') {
+             t->type = TOK_NOT;
+         } else if (c == '(') {
+             t->type = TOK_LPAREN;
+         } else if (c == ')') {
+             t->type = TOK_RPAREN;
+         } else if (isdigit(c)) {
+             t->type = TOK_CONST;
+             t->arg = (unsigned char)(c - '0');
+         } else if (isalpha(c)) {
+             // At most 52 letters, so every variable gets a slot.
+             if (slot_of[c] < 0) {
+                 slot_of[c] = (signed char)prog->var_count;
+                 prog->vars[prog->var_count++] = (char)c;
+             }
+             t->type = TOK_VAR;
+             t->arg = (unsigned char)slot_of[c];
+         } else {
+             // Any other character, multi-byte ones included, is one token.
+             t->type = TOK_UNKNOWN;
+             if (c >= 0xC0) {
+                 while ((*p & 0xC0) == 0x80) {
+                     p++;
+                 }
+             }
+         }
+     }
+     tokens[n].type = TOK_END;
+     tokens[n].arg = 0;
+     return n;
+ }
+ 
+ /* -------------------------------------------------------------------------
+  * parse_expression:
+  *   Parses the token stream into the DAG. Grammar:
+  *     expression = term { '+' term }
+  *     term       = factor { '·' factor }
+  *     factor     = '!' factor | '(' expression ')' | literal
+  *   where a literal is '0', '1' or a variable. The grammar is parsed
+  *   without recursion: every '!', '(' and every operator waiting for its
+  *   right operand is pushed on an explicit stack of (token type, node)
+  *   pairs, which holds at most one entry per token, so arbitrarily deep
+  *   nesting only costs memory proportional to the expression. Nodes are
+  *   created in the same order as by a recursive descent parser.
+  *
+  *   Returns:
+  *     The DAG node of the expression.
+  * ------------------------------------------------------------------------- */
+ static int parse_expression(Parser *ps) {
+     const Token *t = ps->t;
+     int *stack = ps->stack;
+     int top = 0;
+ 
+     for (;;) {
+         // A factor: first its '!' and '(' prefixes, then a literal.
+         while (t->type == TOK_NOT || t->type == TOK_LPAREN) {
+             stack[2 * top] = t->type;
+             stack[2 * top + 1] = -1;
+             top++;
+             t++;
+         }
+         int node;
+         if (t->type == TOK_CONST) {
+             node = dag_node(ps->dag, OP_CONST, t->arg, -1, -1);
+             t++;
+         } else if (t->type == TOK_VAR) {
+             // Variable: its slot j is bit (var_count - j - 1) of the assignment.
+             node = dag_node(ps->dag, OP_VAR, (unsigned char)(ps->var_count - t->arg - 1), -1, -1);
+             t++;
+         } else {
+             // Skip unrecognized characters (could add error handling here).
+             if (t->type != TOK_END) {
+                 t++;
+             }
+             node = dag_node(ps->dag, OP_CONST, 0, -1, -1);
+         }
+ 
+         // Reduce the stack until the next token continues the expression.
+         for (;;) {
+             while (top > 0 && stack[2 * (top - 1)] == TOK_NOT) {
+                 top--;
+                 node = dag_node(ps->dag, OP_NOT, 0, node, -1);
+             }
+             if (top > 0 && stack[2 * (top - 1)] == TOK_AND) {
+                 top--;
+                 node = dag_node(ps->dag, OP_AND, 0, stack[2 * top + 1], node);
+             }
+             if (t->type == TOK_AND) {
+                 break;
+             }
+             if (top > 0 && stack[2 * (top - 1)] == TOK_OR) {
+                 top--;
+                 node = dag_node(ps->dag, OP_OR, 0, stack[2 * top + 1], node);
+             }
+             if (t->type == TOK_OR || top == 0) {
+                 break;
+             }
+             // The end of a grouped expression ( expression ).
+             top--;
+             if (t->type == TOK_RPAREN) {
+                 t++;  // Consume ')'
+             } else {
+                 fprintf(stderr, "Error: Missing closing parenthesis.\n");
+             }
+         }
+         if (t->type != TOK_AND && t->type != TOK_OR) {
+             ps->t = t;
+             return node;
+         }
+ 
+         // Consume '·' or '+' and keep its left operand until the right one
+         // has been parsed.
+         stack[2 * top] = t->type;
+         stack[2 * top + 1] = node;
+         top++;
+         t++;
+     }
+ }
+ 
+ /* -------------------------------------------------------------------------
+  * compile_expression:
+  *   Collects the unique alphabetic variables of an expression and compiles
+  *   it into postfix bytecode.
+  *
+  *   Parameters:
+  *     expr - The Boolean expression as a string.
+  *     prog - Receives the compiled program; release it with free_program.
+  *
+  *   Returns:
+  *     0 on success, -1 if memory could not be allocated.
+  * ------------------------------------------------------------------------- */
+ int compile_expression(const char *expr, Program *prog) {
+     memset(prog, 0, sizeof(*prog));
+     return recompile_expression(expr, prog);
+ }
+ 
+ /* -------------------------------------------------------------------------
+  * recompile_expression:
+  *   Compiles an expression into a program that was already initialized by
+  *   compile_expression, reusing its code buffer whenever it is large enough.
+  *
+  *   Returns:
+  *     0 on success, -1 if memory could not be allocated.
+  * ------------------------------------------------------------------------- */
+ int recompile_expression(const char *expr, Program *prog) {
+     return recompile_expressions(&expr, 1, prog);
+ }
+ 
+ /* -------------------------------------------------------------------------
+  * compile_expressions:
+  *   Compiles a set of expressions into one program with an output for
+  *   each. They are parsed into the same DAG, so a subterm found in several
+  *   of them is computed once, and their variables share one set of slots in
+  *   order of first appearance across the set. After a run, output o (the
+  *   value of exprs[o]) is in stack entry o.
+  *
+  *   Parameters:
+  *     exprs - The Boolean expressions.
+  *     count - Their number, from 1 to MAX_OUTPUTS.
+  *     prog  - Receives the compiled program; release it with free_program.
+  *
+  *   Returns:
+  *     0 on success, -1 if memory could not be allocated or count is out
+  *     of range.
+  * ------------------------------------------------------------------------- */
+ int compile_expressions(const char *const *exprs, int count, Program *prog) {
+     memset(prog, 0, sizeof(*prog));
+     return recompile_expressions(exprs, count, prog);
+ }
+ 
+ /* -------------------------------------------------------------------------
+  * recompile_expressions:
+  *   Compiles a set of expressions like compile_expressions into a program
+  *   that was already initialized, reusing its memory.
+  *
+  *   Returns:
+  *     0 on success, -1 if memory could not be allocated or count is out
+  *     of range.
+  * ------------------------------------------------------------------------- */
+ int recompile_expressions(const char *const *exprs, int count, Program *prog) {
+     prog->length = 0;
+     prog->max_depth = 0;
+     prog->slot_count = 0;
+     prog->var_count = 0;
+     prog->outputs = 0;
+     if (count < 1 || count > MAX_OUTPUTS) {
+         return -1;
+     }
+ 
+     size_t len = 0;
+     for (int i = 0; i < count; i++) {
+         len += strlen(exprs[i]) + 1;
+     }
+     Token small[SMALL_TOKENS];
+     Token *tokens = small;
+     if (len > SMALL_TOKENS) {
+         if (len >= INT_MAX) {
+             return -1;
+         }
+         tokens = malloc(len * sizeof(Token));
+         if (!tokens) {
+             return -1;
+         }
+     }
+     // Every expression is tokenized before any is parsed, since the
+     // assignment bit of a variable depends on the final var_count.
+     int starts[MAX_OUTPUTS];
+     int total = 0;
+     for (int i = 0; i < count; i++) {
+         starts[i] = total;
+         total += tokenize(exprs[i], tokens + total, prog) + 1;
+     }
+ 
+     // The DAG is kept with the program so recompiling reuses its memory.
+     int rc = -1;
+     if (!prog->dag) {
+         prog->dag = calloc(1, sizeof(Dag));
+     }
+     // Every token adds at most one node and one parser stack entry.
+     if (prog->dag && dag_reset(prog->dag, total) == 0) {
+         Dag *dag = prog->dag;
+         if (2 * total > dag->list_capacity) {
+             int *list = grow_array(dag->list, &dag->list_capacity, 2 * total, sizeof(int));
+             if (list) {
+                 dag->list = list;
+             }
+         }
+         if (2 * total <= dag->list_capacity) {
+             int roots[MAX_OUTPUTS];
+             for (int i = 0; i < count; i++) {
+                 Parser ps = { tokens + starts[i], dag, dag->list, prog->var_count };
+                 roots[i] = parse_expression(&ps);
+             }
+             rc = emit_program(dag, roots, count, prog);
+         }
+     }
+     if (tokens != small) {
+         free(tokens);
+     }
+     return rc;
+ }
+ 
+ /* -------------------------------------------------------------------------
+  * free_program:
+  *   Releases the memory owned by a compiled program.
+  * ------------------------------------------------------------------------- */
+ void free_program(Program *prog) {
+     free(prog->code);
+     prog->code = NULL;
+     dag_free(prog->dag);
+     prog->dag = NULL;
+ }
+ 
+ /* -------------------------------------------------------------------------
+  * push_operand:
+  *   Appends a node to the DAG's operand list.
+  * ------------------------------------------------------------------------- */
+ static void push_operand(Dag *dag, int node) {
+     if (dag->list_len == dag->list_capacity) {
+         int *list = grow_array(dag->list, &dag->list_capacity, dag->list_len + 1, sizeof(int));
+         if (!list) {
+             dag->error = 1;
+             return;
+         }
+         dag->list = list;
+     }
+     dag->list[dag->list_len++] = node;
+ }
+ 
+ /* -------------------------------------------------------------------------
+  * gather_operands:
+  *   Appends the operands of the 'op' chain rooted at n to the operand list,
+  *   looking through nested chains of the same operator. When both operands
+  *   of a node are nested chains, the first one waits on a work stack while
+  *   the second is gathered.
+  * ------------------------------------------------------------------------- */
+ static void gather_operands(Dag *dag, int n, unsigned char op) {
+     int pending = 0;
+     for (;;) {
+         while (dag->nodes[n].op == op) {
+             int a = dag->nodes[n].a, b = dag->nodes[n].b;
+             if (dag->nodes[a].op == op) {
+                 if (pending == dag->pending_capacity) {
+                     int *stack = grow_array(dag->pending, &dag->pending_capacity, pending + 1, sizeof(int));
+                     if (!stack) {
+                         dag->error = 1;
+                         return;
+                     }
+                     dag->pending = stack;
+                 }
+                 dag->pending[pending++] = a;
+             } else {
+                 push_operand(dag, a);
+             }
+             n = b;
+         }
+         push_operand(dag, n);
+         if (pending == 0) {
+             return;
+         }
+         n = dag->pending[--pending];
+     }
+ }
+ 
+ /* -------------------------------------------------------------------------
+  * find_operand:
+  *   Returns 1 if 'node' is among the sorted operands list[from..to).
+  * ------------------------------------------------------------------------- */
+ static int find_operand(const Dag *dag, int from, int to, int node) {
+     while (from < to) {
+         int mid = from + (to - from) / 2;
+         if (dag->list[mid] == node) {
+             return 1;
+         }
+         if (dag->list[mid] < node) {
+             from = mid + 1;
+         } else {
+             to = mid;
+         }
+     }
+     return 0;
+ }
+ 
+ /* -------------------------------------------------------------------------
+  * compare_nodes:
+  *   qsort comparator ordering node indices.
+  * ------------------------------------------------------------------------- */
+ static int compare_nodes(const void *pa, const void *pb) {
+     int a = *(const int *)pa, b = *(const int *)pb;
+     return (a > b) - (a < b);
+ }
+ 
+ /* -------------------------------------------------------------------------
+  * build_chain:
+  *   Joins the operands list[from..to) into a left-deep 'op' chain. Equal
+  *   sorted operand lists always produce the same node.
+  * ------------------------------------------------------------------------- */
+ static int build_chain(Dag *dag, unsigned char op, int from, int to) {
+     int result = dag->list[from];
+     for (int i = from + 1; i < to; i++) {
+         result = dag_node(dag, op, 0, result, dag->list[i]);
+     }
+     return result;
+ }
+ 
+ /* -------------------------------------------------------------------------
+  * make_const / make_not:
+  *   Create a constant, and the negation of an already simplified node.
+  * ------------------------------------------------------------------------- */
+ static int make_const(Dag *dag, int value) {
+     return dag_node(dag, OP_CONST, value ? 1 : 0, -1, -1);
+ }
+ 
+ static int make_not(Dag *dag, int x) {
+     if (dag->nodes[x].op == OP_CONST) {
+         return make_const(dag, !dag->nodes[x].arg);
+     }
+     if (dag->nodes[x].op == OP_NOT) {
+         return dag->nodes[x].a;
+     }
+     return dag_node(dag, OP_NOT, 0, x, -1);
+ }
+ 
+ /* -------------------------------------------------------------------------
+  * push_frame:
+  *   Pushes a simplify_node frame for node n onto the DAG's work stack.
+  * ------------------------------------------------------------------------- */
+ static void push_frame(Dag *dag, int *top, int n) {
+     if (3 * (*top + 1) > dag->frame_capacity) {
+         int *frames = grow_array(dag->frames, &dag->frame_capacity, 3 * (*top + 1), sizeof(int));
+         if (!frames) {
+             dag->error = 1;
+             return;
+         }
+         dag->frames = frames;
+     }
+     int *f = &dag->frames[3 * (*top)++];
+     f[0] = n;
+     f[1] = -1;   // list base of its operands, once gathered
+     f[2] = -1;   // next operand to simplify
+ }
+ 
+ /* -------------------------------------------------------------------------
+  * simplify_node:
+  *   Returns the simplified form of node 'root'. Each node is simplified
+  *   once; later requests return the remembered result. The operands of a
+  *   node are simplified before it, depth first on an explicit stack of
+  *   (node, list base, next operand) frames, so the depth of the DAG is not
+  *   limited by the C stack.
+  * ------------------------------------------------------------------------- */
+ static int simplify_node(Dag *dag, int root) {
+     int top = 0;
+     if (dag->nodes[root].simplified < 0) {
+         push_frame(dag, &top, root);
+     }
+     while (top > 0 && !dag->error) {
+         int *f = &dag->frames[3 * (top - 1)];
+         int n = f[0];
+         unsigned char op = dag->nodes[n].op;
+         int result = n;
+         if (op == OP_NOT) {
+             // Strip every negation and simplify what lies beneath them.
+             int negations = 0, x = n;
+             while (dag->nodes[x].op == OP_NOT) {
+                 x = dag->nodes[x].a;
+                 negations++;
+             }
+             if (dag->nodes[x].simplified < 0) {
+                 push_frame(dag, &top, x);
+                 continue;
+             }
+             result = dag->nodes[x].simplified;
+             while (negations-- > 0) {
+                 result = make_not(dag, result);
+             }
+         } else if (op == OP_AND || op == OP_OR) {
+             // Gather the operands on the first visit, then simplify them
+             // in order, resuming here after each one that needed a frame.
+             if (f[1] < 0) {
+                 f[1] = dag->list_len;
+                 f[2] = f[1];
+                 gather_operands(dag, n, op);
+             }
+             int i = f[2];
+             while (i < dag->list_len && dag->nodes[dag->list[i]].simplified >= 0) {
+                 dag->list[i] = dag->nodes[dag->list[i]].simplified;
+                 i++;
+             }
+             if (i < dag->list_len) {
+                 f[2] = i;
+                 push_frame(dag, &top, dag->list[i]);
+                 continue;
+             }
+             result = simplify_list(dag, op, f[1]);
+         }
+         top--;
+         if (dag->error) {
+             break;
+         }
+         dag->nodes[n].simplified = result;
+         dag->nodes[result].simplified = result;
+     }
+     if (dag->error) {
+         return 0;
+     }
+     return dag->nodes[root].simplified;
+ }
+
+ /* -------------------------------------------------------------------------
+  * hoist_factors:
+  *   Hoisting: if every term list[base..end) of an 'op' chain is a 'dual'
+  *   chain and the terms share the operands F1 .. Fs, then
+  *   T1 op T2 ... = F1 dual ... dual Fs dual (T1' op T2' ...), where each
+  *   Ti' is Ti without the shared operands (the constant of an empty 'dual'
+  *   chain if nothing is left). The sorted operands of the terms are
+  *   intersected with one merge per term, and every shared operand is
+  *   stripped in the same pass, so the cost grows with the total size of
+  *   the terms rather than with their product.
+  *
+  *   Returns:
+  *     -1 if the terms share no operand, with the list unchanged. Otherwise
+  *     the list holds F1 .. Fs, then s and 'op', then the terms Ti', and the
+  *     index of the first Ti' is returned.
+  * ------------------------------------------------------------------------- */
+ static int hoist_factors(Dag *dag, unsigned char op, int base, int end) {
+     unsigned char dual = op == OP_AND ? OP_OR : OP_AND;
+     for (int i = base; i < end; i++) {
+         if (dag->nodes[dag->list[i]].op != dual) {
+             return -1;
+         }
+     }
+
+     // The operands shared by the terms so far, kept sorted after the terms.
+     gather_operands(dag, dag->list[base], dual);
+     int shared_end = dag->list_len;
+     qsort(dag->list + end, (size_t)(shared_end - end), sizeof(int), compare_nodes);
+     for (int i = base + 1; i < end && shared_end > end && !dag->error; i++) {
+         gather_operands(dag, dag->list[i], dual);
+         qsort(dag->list + shared_end, (size_t)(dag->list_len - shared_end), sizeof(int),
+               compare_nodes);
+         int w = end, j = shared_end;
+         for (int k = end; k < shared_end && j < dag->list_len; ) {
+             if (dag->list[k] < dag->list[j]) {
+                 k++;
+             } else if (dag->list[k] > dag->list[j]) {
+                 j++;
+             } else {
+                 dag->list[w++] = dag->list[k++];
+                 j++;
+             }
+         }
+         shared_end = dag->list_len = w;
+     }
+     int shared = shared_end - end;
+     if (shared == 0 || dag->error) {
+         dag->list_len = end;
+         return -1;
+     }
+
+     // Strip the shared operands from every term, in place.
+     for (int i = base; i < end && !dag->error; i++) {
+         gather_operands(dag, dag->list[i], dual);
+         qsort(dag->list + shared_end, (size_t)(dag->list_len - shared_end), sizeof(int),
+               compare_nodes);
+         int w = shared_end, k = end;
+         for (int j = shared_end; j < dag->list_len; j++) {
+             while (k < shared_end && dag->list[k] < dag->list[j]) {
+                 k++;
+             }
+             if (k == shared_end || dag->list[k] != dag->list[j]) {
+                 dag->list[w++] = dag->list[j];
+             }
+         }
+         dag->list[i] = w > shared_end ? build_chain(dag, dual, shared_end, w)
+                                       : make_const(dag, dual == OP_AND);
+         dag->list_len = shared_end;
+     }
+
+     // Move the factors, their count and 'op' in front of the remaining terms.
+     int terms = end - base;
+     for (int i = base; i < end; i++) {
+         push_operand(dag, dag->list[i]);
+     }
+     if (dag->error) {
+         return -1;
+     }
+     memmove(dag->list + base, dag->list + end, (size_t)shared * sizeof(int));
+     dag->list[base + shared] = shared;
+     dag->list[base + shared + 1] = op;
+     memmove(dag->list + base + shared + 2, dag->list + shared_end, (size_t)terms * sizeof(int));
+     dag->list_len = base + shared + 2 + terms;
+     return base + shared + 2;
+ }
+
+ /* -------------------------------------------------------------------------
+  * reduce_list:
+  *   Applies every rule but hoisting to the simplified operands
+  *   list[base..list_len) of an 'op' chain.
+  *
+  *   Returns:
+  *     The simplified chain, popped from the list, or -1 if at least two
+  *     operands remain, left sorted in the list.
+  * ------------------------------------------------------------------------- */
+ static int reduce_list(Dag *dag, unsigned char op, int base) {
+     unsigned char dual = op == OP_AND ? OP_OR : OP_AND;
+     int identity = op == OP_AND;
+ 
+     // Flatten nested chains of the same operator and fold constants.
+     int annihilated = 0;
+     for (int i = base; i < dag->list_len && !dag->error; i++) {
+         int n = dag->list[i];
+         if (dag->nodes[n].op == op) {
+             dag->list[i] = -1;
+             gather_operands(dag, n, op);
+         } else if (dag->nodes[n].op == OP_CONST) {
+             dag->list[i] = -1;
+             if ((dag->nodes[n].arg != 0) != identity) {
+                 annihilated = 1;
+             }
+         }
+     }
+     if (annihilated || dag->error) {
+         dag->list_len = base;
+         return make_const(dag, !identity);
+     }
+ 
+     // Sort, which also makes duplicates adjacent (A·A = A).
+     qsort(dag->list + base, (size_t)(dag->list_len - base), sizeof(int), compare_nodes);
+     int w = base;
+     for (int i = base; i < dag->list_len; i++) {
+         int n = dag->list[i];
+         if (n >= 0 && (w == base || dag->list[w - 1] != n)) {
+             dag->list[w++] = n;
+         }
+     }
+     int end = dag->list_len = w;
+ 
+     // Complements: X·!X = 0 and X + !X = 1.
+     for (int i = base; i < end; i++) {
+         int n = dag->list[i];
+         if (dag->nodes[n].op == OP_NOT && find_operand(dag, base, end, dag->nodes[n].a)) {
+             dag->list_len = base;
+             return make_const(dag, !identity);
+         }
+     }
+ 
+     // Absorption: X + X·Y = X and X·(X + Y) = X. The kept operands are
+     // collected after the list and then moved back in place.
+     for (int i = base; i < end; i++) {
+         int n = dag->list[i];
+         int absorbed = 0;
+         if (dag->nodes[n].op == dual) {
+             int inner = dag->list_len;
+             gather_operands(dag, n, dual);
+             for (int j = inner; j < dag->list_len && !absorbed; j++) {
+                 absorbed = find_operand(dag, base, end, dag->list[j]);
+             }
+             dag->list_len = inner;
+         }
+         if (!absorbed) {
+             push_operand(dag, n);
+         }
+     }
+     int count = dag->list_len - end;
+     memmove(dag->list + base, dag->list + end, (size_t)count * sizeof(int));
+     dag->list_len = base + count;
+ 
+     if (count == 0) {
+         return make_const(dag, identity);
+     }
+     if (count == 1) {
+         dag->list_len = base;
+         return dag->list[base];
+     }
+ 
+     return -1;
+ }
+
+ /* -------------------------------------------------------------------------
+  * simplify_list:
+  *   Reduces the simplified operands list[base..list_len) of an 'op' chain
+  *   and pops them from the list. After a hoist the remaining terms are
+  *   simplified first, then the hoisted factors together with what those
+  *   terms leave, as a 'dual' chain that may hoist in turn. The pending
+  *   factors stay in the list with their count and operator, so this loops
+  *   instead of recursing however many hoists an expression takes.
+  *
+  *   Returns:
+  *     The simplified chain.
+  * ------------------------------------------------------------------------- */
+ static int simplify_list(Dag *dag, unsigned char op, int base) {
+     int pending = 0;   // hoists whose factors still wait in the list
+     for (;;) {
+         int result = reduce_list(dag, op, base);
+         if (result < 0) {
+             int end = dag->list_len;
+             int inner = hoist_factors(dag, op, base, end);
+             if (inner >= 0) {
+                 base = inner;
+                 pending++;
+                 continue;
+             }
+             result = build_chain(dag, op, base, end);
+             dag->list_len = base;
+         }
+         if (pending == 0 || dag->error) {
+             return result;
+         }
+         // Join the factors of the innermost hoist with its result.
+         int factors = dag->list[base - 2];
+         op = dag->list[base - 1] == OP_AND ? OP_OR : OP_AND;
+         base -= factors + 2;
+         dag->list_len = base + factors;
+         push_operand(dag, result);
+         pending--;
+     }
+ }
+
+ /* -------------------------------------------------------------------------
+  * optimize_program:
+  *   Simplifies a compiled program in place. The program is turned back
+  *   into its DAG, and every chain of '+' or '·' is flattened into a list of
+  *   simplified operands, sorted by node index, that is then reduced:
+  *     - constants are folded (A·0 = 0, A + 0 = A, !1 = 0),
+  *     - double negations are removed (!!A = A),
+  *     - duplicates are dropped and complements collapse (A·A = A,
+  *       A + !A = 1),
+  *     - absorbed terms are dropped (A + A·B = A, A·(A + B) = A),
+  *     - the factors shared by every term are hoisted out
+  *       (A·B + A·C = A·(B + C)).
+  *   The optimized program computes the same function of the same
+  *   variables. Call it before binding evaluators to the program, since its
+  *   stack depth and temporaries may change.
+  *
+  *   Returns:
+  *     0 on success, -1 if memory could not be allocated, in which case the
+  *     program is left unchanged.
+  * ------------------------------------------------------------------------- */
+ int optimize_program(Program *prog) {
+     if (prog->length == 0) {
+         return 0;
+     }
+     if (!prog->dag) {
+         prog->dag = calloc(1, sizeof(Dag));
+         if (!prog->dag) {
+             return -1;
+         }
+     }
+     Dag *dag = prog->dag;
+     int scratch = prog->max_depth + prog->slot_count;
+     if (dag_reset(dag, prog->length + 1) != 0) {
+         return -1;
+     }
+     if (scratch > dag->list_capacity) {
+         int *list = grow_array(dag->list, &dag->list_capacity, scratch, sizeof(int));
+         if (!list) {
+             return -1;
+         }
+         dag->list = list;
+     }
+ 
+     // Rebuild the DAG from the postfix code, then simplify from its roots.
+     int *stack = dag->list;
+     int *slots = dag->list + prog->max_depth;
+     int top = 0;
+     for (int i = 0; i < prog->length; i++) {
+         const Instr *in = &prog->code[i];
+         switch (in->op) {
+         case OP_CONST:
+         case OP_VAR:
+             stack[top++] = dag_node(dag, in->op, (unsigned char)in->arg, -1, -1);
+             break;
+         case OP_NOT:
+             stack[top - 1] = dag_node(dag, OP_NOT, 0, stack[top - 1], -1);
+             break;
+         case OP_AND:
+         case OP_OR:
+             top--;
+             stack[top - 1] = dag_node(dag, in->op, 0, stack[top - 1], stack[top]);
+             break;
+         case OP_STORE:
+             slots[in->arg] = stack[top - 1];
+             break;
+         case OP_LOAD:
+             stack[top++] = slots[in->arg];
+             break;
+         }
+     }
+     // Output o is left in stack entry o; copy the roots out of the list,
+     // which simplify_node reuses.
+     int roots[MAX_OUTPUTS];
+     int count = prog->outputs;
+     memcpy(roots, stack, (size_t)count * sizeof(int));
+     dag->list_len = 0;
+     for (int i = 0; i < count; i++) {
+         roots[i] = simplify_node(dag, roots[i]);
+     }
+     if (dag->error) {
+         return -1;
+     }
+     return emit_program(dag, roots, count, prog);
+ }
+ 
+ /* -------------------------------------------------------------------------
+  * evaluator_init:
+  *   Prepares an evaluator for a compiled program with every variable false.
+  *   Each thread evaluating the same program needs its own evaluator.
+  *
+  *   Returns:
+  *     0 on success, -1 if memory could not be allocated.
+  * ------------------------------------------------------------------------- */
+ int evaluator_init(Evaluator *ev, const Program *prog) {
+     ev->stack = ev->small_stack;
+     ev->stack_capacity = (int)sizeof(ev->small_stack);
+     return evaluator_bind(ev, prog);
+ }
+ 
+ /* -------------------------------------------------------------------------
+  * evaluator_bind:
+  *   Points an initialized evaluator at another program and clears every
+  *   variable, reusing the value stack whenever it is deep enough.
+  *
+  *   Returns:
+  *     0 on success, -1 if memory could not be allocated.
+  * ------------------------------------------------------------------------- */
+ int evaluator_bind(Evaluator *ev, const Program *prog) {
+     ev->prog = prog;
+     ev->values = 0;
+     int needed = prog->max_depth + prog->slot_count;
+     if (needed > ev->stack_capacity) {
+         unsigned char *stack = malloc((size_t)needed);
+         if (!stack) {
+             return -1;
+         }
+         if (ev->stack != ev->small_stack) {
+             free(ev->stack);
+         }
+         ev->stack = stack;
+         ev->stack_capacity = needed;
+     }
+     return 0;
+ }
+ 
+ /* -------------------------------------------------------------------------
+  * apply_assignments:
+  *   Sets variables from a comma-separated list such as "A=0, B=1".
+  *
+  *   Parameters:
+  *     ev   - The evaluator receiving the values.
+  *     list - The assignment list; an empty list assigns nothing.
+  *
+  *   Returns:
+  *     0 on success, -1 if the list is malformed.
+  * ------------------------------------------------------------------------- */
+ int apply_assignments(Evaluator *ev, const char *list) {
+     const char *s = list;
+     skip_whitespace(&s);
+     while (*s) {
+         char var = *s++;
+         skip_whitespace(&s);
+         if (!isalpha(var) || *s++ != '=') {
+             return -1;
+         }
+         skip_whitespace(&s);
+         if (*s != '0' && *s != '1') {
+             return -1;
+         }
+         evaluator_set(ev, var, *s++ - '0');
+         skip_whitespace(&s);
+         if (*s == ',') {
+             s++;
+             skip_whitespace(&s);
+         } else if (*s) {
+             return -1;
+         }
+     }
+     return 0;
+ }
+ 
+ /* -------------------------------------------------------------------------
+  * evaluator_set:
+  *   Sets the value of a variable; variables not in the program are ignored.
+  * ------------------------------------------------------------------------- */
+ void evaluator_set(Evaluator *ev, char var, int value) {
+     const Program *prog = ev->prog;
+     for (int j = 0; j < prog->var_count; j++) {
+         if (prog->vars[j] == var) {
+             uint64_t bit = 1ULL << (prog->var_count - j - 1);
+             ev->values = value ? (ev->values | bit) : (ev->values & ~bit);
+             return;
+         }
+     }
+ }
+ 
+ /* -------------------------------------------------------------------------
+  * evaluator_run:
+  *   Evaluates the program for the evaluator's current variable values.
+  *
+  *   Returns:
+  *     The evaluated result (0 or 1).
+  * ------------------------------------------------------------------------- */
+ int evaluator_run(Evaluator *ev) {
+     const Program *prog = ev->prog;
+     uint64_t values = ev->values;
+     unsigned char *stack = ev->stack;
+     unsigned char *slots = stack + prog->max_depth;
+     int top = 0;
+     for (int i = 0; i < prog->length; i++) {
+         const Instr *in = &prog->code[i];
+         switch (in->op) {
+         case OP_CONST:
+             stack[top++] = in->arg;
+             break;
+         case OP_VAR:
+             stack[top++] = (values >> in->arg) & 1;
+             break;
+         case OP_NOT:
+             stack[top - 1] = !stack[top - 1];
+             break;
+         case OP_AND:
+             top--;
+             stack[top - 1] = (stack[top - 1] && stack[top]) ? 1 : 0;
+             break;
+         case OP_OR:
+             top--;
+             stack[top - 1] = (stack[top - 1] || stack[top]) ? 1 : 0;
+             break;
+         case OP_STORE:
+             slots[in->arg] = stack[top - 1];
+             break;
+         case OP_LOAD:
+             stack[top++] = slots[in->arg];
+             break;
+         }
+     }
+     return stack[0];
+ }
+ 
+ /* -------------------------------------------------------------------------
+  * evaluator_free:
+  *   Releases the memory owned by an evaluator.
+  * ------------------------------------------------------------------------- */
+ void evaluator_free(Evaluator *ev) {
+     if (ev->stack != ev->small_stack) {
+         free(ev->stack);
+     }
+     ev->stack = NULL;
+     ev->stack_capacity = 0;
+ }
+ 
+ /* -------------------------------------------------------------------------
+  * kernel_init:
+  *   Prepares a kernel for a compiled program. It interprets the program
+  *   until translating it is expected to pay off.
+  *
+  *   Returns:
+  *     0 on success, -1 if memory could not be allocated.
+  * ------------------------------------------------------------------------- */
+ int kernel_init(Kernel *k, const Program *prog) {
+     memset(k, 0, sizeof(*k));
+     k->prog = prog;
+ #ifdef KERNEL_JIT
+     k->budget = KERNEL_NATIVE_WORK / ((uint64_t)prog->length + 1) + 1;
+ #endif
+     k->scratch = malloc(((size_t)prog->max_depth + prog->slot_count + 1) * sizeof(uint64_t));
+     return k->scratch ? 0 : -1;
+ }
+ 
+ #ifdef KERNEL_JIT
+ /* The first KERNEL_REGS entries of the evaluation stack are kept in rax,
+  * rcx, rdx, r8, r9 and r10; deeper entries and the temporaries live in the
+  * scratch words at rsi, and r11 carries them. The slices are at rdi. */
+ #define KERNEL_REGS 6
+ static const unsigned char kernel_regs[KERNEL_REGS] = { 0, 1, 2, 8, 9, 10 };
+ enum { REG_RSI = 6, REG_RDI = 7, REG_R11 = 11 };
+ 
+ /* -------------------------------------------------------------------------
+  * emit_rr / emit_rm:
+  *   Emit a 64-bit instruction with register operand 'reg' (or opcode
+  *   extension) and a register 'rm', or the memory operand [base + disp].
+  * ------------------------------------------------------------------------- */
+ static unsigned char *emit_rr(unsigned char *p, unsigned char opcode, int reg, int rm) {
+     *p++ = (unsigned char)(0x48 | (reg >= 8) << 2 | (rm >= 8));
+     *p++ = opcode;
+     *p++ = (unsigned char)(0xC0 | (reg & 7) << 3 | (rm & 7));
+     return p;
+ }
+ 
+ static unsigned char *emit_rm(unsigned char *p, unsigned char opcode, int reg, int base,
+                               uint32_t disp) {
+     *p++ = (unsigned char)(0x48 | (reg >= 8) << 2 | (base >= 8));
+     *p++ = opcode;
+     *p++ = (unsigned char)(0x80 | (reg & 7) << 3 | (base & 7));
+     for (int i = 0; i < 4; i++) {
+         *p++ = (unsigned char)(disp >> (8 * i));
+     }
+     return p;
+ }
+ 
+ /* -------------------------------------------------------------------------
+  * kernel_emit:
+  *   Translates a program into a KernelFunction at 'code', which must have
+  *   room for 16 bytes per instruction and 64 more.
+  * ------------------------------------------------------------------------- */
+ static void kernel_emit(const Program *prog, unsigned char *code) {
+     enum { MOV_LOAD = 0x8B, MOV_STORE = 0x89, AND = 0x21, OR = 0x09, XOR = 0x31,
+            MOV_IMM = 0xC7, NOT = 0xF7 };
+     unsigned char *p = code;
+     uint32_t slots = 8 * (uint32_t)prog->max_depth;
+     int top = 0;
+     for (int i = 0; i < prog->length; i++) {
+         const Instr *in = &prog->code[i];
+         // The register of the top entry, or r11 if it is kept in memory.
+         int r = top < KERNEL_REGS ? kernel_regs[top] : REG_R11;
+         int below = top > 0 && top - 1 < KERNEL_REGS ? kernel_regs[top - 1] : REG_R11;
+         switch (in->op) {
+         case OP_CONST:
+         case OP_VAR:
+         case OP_LOAD:
+             if (in->op == OP_VAR) {
+                 p = emit_rm(p, MOV_LOAD, r, REG_RDI, 8 * in->arg);
+             } else if (in->op == OP_LOAD) {
+                 p = emit_rm(p, MOV_LOAD, r, REG_RSI, slots + 8 * in->arg);
+             } else if (in->arg) {
+                 p = emit_rr(p, MOV_IMM, 0, r);
+                 memset(p, 0xFF, 4);  // -1, sign-extended
+                 p += 4;
+             } else {
+                 p = emit_rr(p, XOR, r, r);
+             }
+             if (r == REG_R11) {
+                 p = emit_rm(p, MOV_STORE, REG_R11, REG_RSI, 8 * (uint32_t)top);
+             }
+             top++;
+             break;
+         case OP_NOT:
+             if (below == REG_R11) {
+                 p = emit_rm(p, NOT, 2, REG_RSI, 8 * (uint32_t)(top - 1));
+             } else {
+                 p = emit_rr(p, NOT, 2, below);
+             }
+             break;
+         case OP_AND:
+         case OP_OR: {
+             // top - 1 is the right operand, top - 2 the left one and the result.
+             top--;
+             unsigned char op = in->op == OP_AND ? AND : OR;
+             int src = top < KERNEL_REGS ? kernel_regs[top] : REG_R11;
+             if (src == REG_R11) {
+                 p = emit_rm(p, MOV_LOAD, REG_R11, REG_RSI, 8 * (uint32_t)top);
+             }
+             if (top - 1 < KERNEL_REGS) {
+                 p = emit_rr(p, op, src, kernel_regs[top - 1]);
+             } else {
+                 p = emit_rm(p, op, src, REG_RSI, 8 * (uint32_t)(top - 1));
+             }
+             break;
+         }
+         case OP_STORE:
+             if (below == REG_R11) {
+                 p = emit_rm(p, MOV_LOAD, REG_R11, REG_RSI, 8 * (uint32_t)(top - 1));
+             }
+             p = emit_rm(p, MOV_STORE, below, REG_RSI, slots + 8 * in->arg);
+             break;
+         }
+     }
+     // Every output but the first goes to its stack entry in scratch.
+     for (int o = 1; o < prog->outputs && o < KERNEL_REGS; o++) {
+         p = emit_rm(p, MOV_STORE, kernel_regs[o], REG_RSI, 8 * (uint32_t)o);
+     }
+     *p = 0xC3;  // ret, with the first output in rax
+ }
+ #endif
+ 
+ /* -------------------------------------------------------------------------
+  * kernel_compile:
+  *   Translates the kernel's program into machine code right away instead
+  *   of waiting for its budget to run out.
+  *
+  *   Returns:
+  *     0 if the kernel now runs native code, -1 if it keeps interpreting.
+  * ------------------------------------------------------------------------- */
+ int kernel_compile(Kernel *k) {
+     k->budget = 0;
+ #ifdef KERNEL_JIT
+     if (k->native) {
+         return 0;
+     }
+     // Written first, then made executable, never both at once.
+     size_t page = (size_t)sysconf(_SC_PAGESIZE);
+     size_t size = ((size_t)k->prog->length * 16 + 64 + page - 1) / page * page;
+     void *code = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+     if (code == MAP_FAILED) {
+         return -1;
+     }
+     kernel_emit(k->prog, code);
+     if (mprotect(code, size, PROT_READ | PROT_EXEC) != 0) {
+         munmap(code, size);
+         return -1;
+     }
+     k->code = code;
+     k->code_size = size;
+     k->native = (KernelFunction)code;
+     return 0;
+ #else
+     return -1;
+ #endif
+ }
+ 
+ /* -------------------------------------------------------------------------
+  * kernel_interpret:
+  *   Runs the program over words, as evaluator_run does over single bits.
+  * ------------------------------------------------------------------------- */
+ static uint64_t kernel_interpret(const Kernel *k, const uint64_t *slices) {
+     const Program *prog = k->prog;
+     uint64_t *stack = k->scratch;
+     uint64_t *slots = stack + prog->max_depth;
+     int top = 0;
+     for (int i = 0; i < prog->length; i++) {
+         const Instr *in = &prog->code[i];
+         switch (in->op) {
+         case OP_CONST:
+             stack[top++] = in->arg ? ~0ULL : 0;
+             break;
+         case OP_VAR:
+             stack[top++] = slices[in->arg];
+             break;
+         case OP_NOT:
+             stack[top - 1] = ~stack[top - 1];
+             break;
+         case OP_AND:
+             top--;
+             stack[top - 1] &= stack[top];
+             break;
+         case OP_OR:
+             top--;
+             stack[top - 1] |= stack[top];
+             break;
+         case OP_STORE:
+             slots[in->arg] = stack[top - 1];
+             break;
+         case OP_LOAD:
+             stack[top++] = slots[in->arg];
+             break;
+         }
+     }
+     return stack[0];
+ }
+ 
+ /* -------------------------------------------------------------------------
+  * kernel_run:
+  *   Evaluates the program for the 64 assignments given as bitslices.
+  *
+  *   Parameters:
+  *     k      - The kernel.
+  *     slices - One word per assignment bit of the program's variables.
+  *
+  *   Returns:
+  *     The 64 results, bit k for the k-th assignment. A program with several
+  *     outputs returns the first, and leaves output o in k->scratch[o].
+  * ------------------------------------------------------------------------- */
+ uint64_t kernel_run(Kernel *k, const uint64_t *slices) {
+     if (k->native) {
+         return k->native(slices, k->scratch);
+     }
+     if (k->budget > 0 && --k->budget == 0 && kernel_compile(k) == 0) {
+         return k->native(slices, k->scratch);
+     }
+     return kernel_interpret(k, slices);
+ }
+ 
+ /* -------------------------------------------------------------------------
+  * kernel_free:
+  *   Releases the machine code and scratch memory owned by a kernel.
+  * ------------------------------------------------------------------------- */
+ void kernel_free(Kernel *k) {
+     if (k->code) {
+         munmap(k->code, k->code_size);
+     }
+     free(k->scratch);
+     k->code = NULL;
+     k->native = NULL;
+     k->scratch = NULL;
+ }
+ 
+ /* -------------------------------------------------------------------------
+  * run_program_block:
+  *   Evaluates a compiled program for all BLOCK_ROWS rows of a block at once.
+  *
+  *   Parameters:
+  *     prog      - The compiled program.
+  *     first_row - Index of the block's first row (a multiple of BLOCK_ROWS).
+  *     stack     - Scratch space for prog->max_depth + prog->slot_count
+  *                 vectors.
+  *     out       - Receives one result bit per row, BLOCK_WORDS words for
+  *                 each output of the program.
+  *     stride    - Distance in words from one output's results to the next.
+  * ------------------------------------------------------------------------- */
+ BITSLICE_KERNEL
+ void run_program_block(const Program *prog, uint64_t first_row,
+                        vword *stack, uint64_t *out, size_t stride) {
+     const vword zero = {0};
+     uint64_t first_word = first_row / 64;
+     vword *slots = stack + prog->max_depth;
+     int top = 0;
+     for (int i = 0; i < prog->length; i++) {
+         const Instr *in = &prog->code[i];
+         switch (in->op) {
+         case OP_CONST:
+             stack[top++] = in->arg ? ~zero : zero;
+             break;
+         case OP_VAR:
+             if (in->arg < 6) {
+                 stack[top++] = zero | low_patterns[in->arg];
+             } else {
+                 /* Higher bits are constant within a word */
+                 vword v = zero;
+                 for (int w = 0; w < BLOCK_WORDS; w++) {
+                     v[w] = -(((first_word + w) >> (in->arg - 6)) & 1);
+                 }
+                 stack[top++] = v;
+             }
+             break;
+         case OP_NOT:
+             stack[top - 1] = ~stack[top - 1];
+             break;
+         case OP_AND:
+             top--;
+             stack[top - 1] &= stack[top];
+             break;
+         case OP_OR:
+             top--;
+             stack[top - 1] |= stack[top];
+             break;
+         case OP_STORE:
+             slots[in->arg] = stack[top - 1];
+             break;
+         case OP_LOAD:
+             stack[top++] = slots[in->arg];
+             break;
+         }
+     }
+     for (int o = 0; o < prog->outputs; o++) {
+         memcpy(out + o * stride, &stack[o], sizeof(vword));
+     }
+ }
+ 
+ /* -------------------------------------------------------------------------
+  * evaluate_chunk:
+  *   Evaluates up to CHUNK_ROWS rows starting at first_row (a multiple of
+  *   BLOCK_ROWS) into out, one bit per row in CHUNK_WORDS words per output.
+  * ------------------------------------------------------------------------- */
+ static void evaluate_chunk(const Program *prog, vword *stack, uint64_t first_row,
+                            uint64_t count, uint64_t *out) {
+     uint64_t blocks = (count + BLOCK_ROWS - 1) / BLOCK_ROWS;
+     for (uint64_t b = 0; b < blocks; b++) {
+         run_program_block(prog, first_row + b * BLOCK_ROWS, stack, out + b * BLOCK_WORDS,
+                           CHUNK_WORDS);
+     }
+ }
+ 
+ /* -------------------------------------------------------------------------
+  * shift_results:
+  *   Moves a bitmap of results down by 'bits' rows, so that bit 0 holds
+  *   what was the result of row 'bits'.
+  * ------------------------------------------------------------------------- */
+ static void shift_results(uint64_t *results, size_t words, uint64_t bits) {
+     size_t skip = (size_t)(bits / 64);
+     unsigned shift = (unsigned)(bits % 64);
+     for (size_t i = 0; i + skip < words; i++) {
+         uint64_t lo = results[i + skip];
+         uint64_t hi = i + skip + 1 < words ? results[i + skip + 1] : 0;
+         results[i] = shift ? (lo >> shift) | (hi << (64 - shift)) : lo;
+     }
+ }
+
+ /* -------------------------------------------------------------------------
+  * enumerator_init:
+  *   Prepares an enumerator over every row of the program's truth table.
+  *
+  *   Returns:
+  *     0 on success, -1 if memory could not be allocated.
+  * ------------------------------------------------------------------------- */
+ int enumerator_init(RowEnumerator *e, const Program *prog) {
+     e->prog = prog;
+     e->next_row = 0;
+     e->end_row = 1ULL << prog->var_count;
+     e->stack = aligned_alloc(sizeof(vword),
+                              (prog->max_depth + prog->slot_count + 1) * sizeof(vword));
+     e->results = malloc((size_t)prog->outputs * CHUNK_WORDS * sizeof(uint64_t));
+     if (!e->stack || !e->results) {
+         enumerator_free(e);
+         return -1;
+     }
+     return 0;
+ }
+ 
+ /* -------------------------------------------------------------------------
+  * enumerator_next:
+  *   Evaluates the next chunk of rows into e->results.
+  *
+  *   Parameters:
+  *     e         - The enumerator.
+  *     first_row - Receives the index of the chunk's first row.
+  *
+  *   Returns:
+  *     The number of rows in the chunk, or 0 once every row has been visited.
+  * ------------------------------------------------------------------------- */
+ uint64_t enumerator_next(RowEnumerator *e, uint64_t *first_row) {
+     if (e->next_row >= e->end_row) {
+         return 0;
+     }
+     // Chunks after the first one of a range start on a block boundary.
+     uint64_t start = e->next_row & ~(uint64_t)(BLOCK_ROWS - 1);
+     uint64_t end = start + CHUNK_ROWS < e->end_row ? start + CHUNK_ROWS : e->end_row;
+     evaluate_chunk(e->prog, e->stack, start, end - start, e->results);
+     if (e->next_row > start) {
+         for (int o = 0; o < e->prog->outputs; o++) {
+             shift_results(e->results + o * CHUNK_WORDS, CHUNK_WORDS, e->next_row - start);
+         }
+     }
+     *first_row = e->next_row;
+     e->next_row = end;
+     return end - *first_row;
+ }
+
+ /* -------------------------------------------------------------------------
+  * enumerator_range:
+  *   Limits an enumerator to the 'count' rows starting at 'first_row', which
+  *   need not be aligned; rows past the end of the table are dropped.
+  * ------------------------------------------------------------------------- */
+ void enumerator_range(RowEnumerator *e, uint64_t first_row, uint64_t count) {
+     uint64_t total = 1ULL << e->prog->var_count;
+     e->next_row = first_row < total ? first_row : total;
+     e->end_row = count < total - e->next_row ? e->next_row + count : total;
+ }
+ 
+ /* -------------------------------------------------------------------------
+  * enumerator_free:
+  *   Releases the scratch and result memory owned by an enumerator.
+  * ------------------------------------------------------------------------- */
+ void enumerator_free(RowEnumerator *e) {
+     free(e->stack);
+     free(e->results);
+     e->stack = NULL;
+     e->results = NULL;
+ }
+ 
+ /* -------------------------------------------------------------------------
+  * Gray-code enumeration, see GrayEnumerator in boolsolve.h. The program is
+  * turned back into its subterms, one GrayNode per value it computes.
+  * ------------------------------------------------------------------------- */
+ struct GrayNode {
+     unsigned char op;         /* OP_CONST, OP_VAR, OP_NOT, OP_AND or OP_OR */
+     unsigned char arg;        /* value of OP_CONST, assignment bit of OP_VAR */
+     int a, b;                 /* operand nodes, -1 if unused */
+ };
+ 
+ /* -------------------------------------------------------------------------
+  * gray_value:
+  *   Computes a node over the enumerator's current word from the values of
+  *   its operands.
+  * ------------------------------------------------------------------------- */
+ static inline uint64_t gray_value(const GrayEnumerator *g, const GrayNode *d) {
+     switch (d->op) {
+     case OP_CONST:
+         return d->arg ? ~0ULL : 0;
+     case OP_VAR:
+         if (d->arg < 6) {
+             return low_patterns[d->arg];
+         }
+         return -((g->word >> (d->arg - 6)) & 1);
+     case OP_NOT:
+         return ~g->values[d->a];
+     case OP_AND:
+         return g->values[d->a] & g->values[d->b];
+     default:
+         return g->values[d->a] | g->values[d->b];
+     }
+ }
+ 
+ /* -------------------------------------------------------------------------
+  * gray_move:
+  *   Moves the enumerator to another word, recomputing the nodes that
+  *   depend on a variable whose value differs between the two words.
+  * ------------------------------------------------------------------------- */
+ static void gray_move(GrayEnumerator *g, uint64_t word) {
+     uint64_t changed = word ^ g->word;
+     g->word = word;
+     while (changed) {
+         int bit = __builtin_ctzll(changed) + 6;
+         changed &= changed - 1;
+         for (int i = g->dep_start[bit]; i < g->dep_start[bit + 1]; i++) {
+             int n = g->deps[i];
+             g->values[n] = gray_value(g, &g->nodes[n]);
+         }
+     }
+ }
+ 
+ /* -------------------------------------------------------------------------
+  * gray_permute:
+  *   Reorders the 64 rows of a word into Gray-code order: bit j of the
+  *   result is bit j ^ (j >> 1) ^ flip of x, where flip is 32 on the odd
+  *   steps of the walk, which enter the word from its other half.
+  * ------------------------------------------------------------------------- */
+ static uint64_t gray_permute(uint64_t x, unsigned flip) {
+     uint64_t out = 0;
+     for (unsigned j = 0; j < 64; j++) {
+         out |= ((x >> ((j ^ (j >> 1)) ^ flip)) & 1) << j;
+     }
+     return out;
+ }
+ 
+ /* -------------------------------------------------------------------------
+  * gray_init:
+  *   Prepares a Gray-code enumerator over every row of the program's truth
+  *   table: rebuilds the program's subterms, lists the ones depending on
+  *   each variable above the six lowest row bits, and evaluates the first
+  *   word.
+  *
+  *   Parameters:
+  *     g          - The enumerator.
+  *     prog       - The compiled program.
+  *     gray_order - Nonzero to leave the results in Gray-code order.
+  *
+  *   Returns:
+  *     0 on success, -1 if memory could not be allocated or the program has
+  *     more than one output.
+  * ------------------------------------------------------------------------- */
+ int gray_init(GrayEnumerator *g, const Program *prog, int gray_order) {
+     memset(g, 0, sizeof(*g));
+     if (prog->outputs != 1) {
+         return -1;
+     }
+     g->prog = prog;
+     g->gray_order = gray_order;
+     g->end = 1ULL << prog->var_count;
+ 
+     size_t length = (size_t)prog->length + 1;
+     g->nodes = malloc(length * sizeof(GrayNode));
+     g->values = malloc(length * sizeof(uint64_t));
+     uint64_t *support = malloc(length * sizeof(uint64_t));
+     int *stack = malloc(((size_t)prog->max_depth + prog->slot_count + 1) * sizeof(int));
+     if (!g->nodes || !g->values || !support || !stack) {
+         free(support);
+         free(stack);
+         gray_free(g);
+         return -1;
+     }
+ 
+     // Rebuild the subterms from the postfix code, noting the row bits
+     // above the lowest six that each one depends on.
+     int *slots = stack + prog->max_depth;
+     int top = 0, count = 0;
+     for (int i = 0; i < prog->length; i++) {
+         const Instr *in = &prog->code[i];
+         GrayNode *d = &g->nodes[count];
+         d->op = in->op;
+         d->arg = 0;
+         d->a = d->b = -1;
+         switch (in->op) {
+         case OP_CONST:
+         case OP_VAR:
+             d->arg = (unsigned char)in->arg;
+             support[count] = in->op == OP_VAR && in->arg >= 6 ? 1ULL << (in->arg - 6) : 0;
+             stack[top++] = count++;
+             break;
+         case OP_NOT:
+             d->a = stack[top - 1];
+             support[count] = support[d->a];
+             stack[top - 1] = count++;
+             break;
+         case OP_AND:
+         case OP_OR:
+             top--;
+             d->a = stack[top - 1];
+             d->b = stack[top];
+             support[count] = support[d->a] | support[d->b];
+             stack[top - 1] = count++;
+             break;
+         case OP_STORE:
+             slots[in->arg] = stack[top - 1];
+             break;
+         case OP_LOAD:
+             stack[top++] = slots[in->arg];
+             break;
+         }
+     }
+     g->node_count = count;
+     g->root = count > 0 ? stack[0] : 0;
+     free(stack);
+ 
+     // Count the dependents of every row bit, then list them in node order,
+     // which evaluates operands before the nodes using them.
+     size_t total = 0;
+     for (int n = 0; n < count; n++) {
+         for (uint64_t bits = support[n]; bits; bits &= bits - 1) {
+             g->dep_start[__builtin_ctzll(bits) + 6 + 1]++;
+             total++;
+         }
+     }
+     for (int b = 0; b < MAX_VARS; b++) {
+         g->dep_start[b + 1] += g->dep_start[b];
+     }
+     g->deps = total < INT_MAX ? malloc((total + 1) * sizeof(int)) : NULL;
+     if (!g->deps) {
+         free(support);
+         gray_free(g);
+         return -1;
+     }
+     int fill[MAX_VARS];
+     memcpy(fill, g->dep_start, sizeof(fill));
+     for (int n = 0; n < count; n++) {
+         for (uint64_t bits = support[n]; bits; bits &= bits - 1) {
+             g->deps[fill[__builtin_ctzll(bits) + 6]++] = n;
+         }
+     }
+     free(support);
+ 
+     // Evaluate everything once for word 0.
+     g->word = 0;
+     for (int n = 0; n < count; n++) {
+         g->values[n] = gray_value(g, &g->nodes[n]);
+     }
+     return 0;
+ }
+ 
+ /* -------------------------------------------------------------------------
+  * gray_next:
+  *   Evaluates the next chunk of rows into g->results. In row order, the
+  *   words of the chunk are visited in Gray-code order and each result is
+  *   stored at its own row; in Gray-code order, the walk goes on across the
+  *   whole table and the results are stored as they come.
+  *
+  *   Parameters:
+  *     g     - The enumerator.
+  *     first - Receives the chunk's first row, or its first position in
+  *             Gray-code order.
+  *
+  *   Returns:
+  *     The number of rows in the chunk, or 0 once every row has been visited.
+  * ------------------------------------------------------------------------- */
+ uint64_t gray_next(GrayEnumerator *g, uint64_t *first) {
+     if (g->next >= g->end) {
+         return 0;
+     }
+     uint64_t count = g->end - g->next < CHUNK_ROWS ? g->end - g->next : CHUNK_ROWS;
+     uint64_t words = (count + 63) / 64;
+     uint64_t base = g->next / 64;
+     for (uint64_t k = 0; k < words; k++) {
+         if (g->gray_order) {
+             uint64_t step = base + k;
+             gray_move(g, step ^ (step >> 1));
+             g->results[k] = gray_permute(g->values[g->root], (unsigned)(step & 1) << 5);
+         } else {
+             // Chunks are aligned to their size, a power of two, so the
+             // Gray code of k stays within the chunk.
+             uint64_t offset = k ^ (k >> 1);
+             gray_move(g, base + offset);
+             g->results[offset] = g->values[g->root];
+         }
+     }
+     *first = g->next;
+     g->next += count;
+     return count;
+ }
+ 
+ /* -------------------------------------------------------------------------
+  * gray_free:
+  *   Releases the memory owned by a Gray-code enumerator.
+  * ------------------------------------------------------------------------- */
+ void gray_free(GrayEnumerator *g) {
+     free(g->nodes);
+     free(g->values);
+     free(g->deps);
+     g->nodes = NULL;
+     g->values = NULL;
+     g->deps = NULL;
+ }
+ 
+ /* -------------------------------------------------------------------------
+  * gray_truth_table:
+  *   Evaluates every row of a program's truth table with a Gray-code
+  *   enumerator on the calling thread and passes the results to 'callback'
+  *   chunk by chunk, in row order or in Gray-code order.
+  *
+  *   Returns:
+  *     0 on success, -1 if memory could not be allocated or the program has
+  *     more than one output.
+  * ------------------------------------------------------------------------- */
+ int gray_truth_table(const Program *prog, int gray_order, ChunkCallback callback,
+                      void *ctx) {
+     GrayEnumerator *g = malloc(sizeof(GrayEnumerator));
+     if (!g || gray_init(g, prog, gray_order) != 0) {
+         free(g);
+         return -1;
+     }
+     uint64_t first, count;
+     while ((count = gray_next(g, &first)) > 0) {
+         callback(ctx, first, count, g->results);
+     }
+     gray_free(g);
+     free(g);
+     return 0;
+ }
+ 
+ /* -------------------------------------------------------------------------
+  * take_chunk:
+  *   Takes the next chunk from a worker's own range, or steals one from the
+  *   back of the range with the most chunks left.
+  *
+  *   Returns:
+  *     1 with *chunk set, or 0 once the whole window has been handed out.
+  * ------------------------------------------------------------------------- */
+ static int take_chunk(TablePool *pool, int self, uint64_t *chunk) {
+     WorkRange *own = &pool->ranges[self];
+     pthread_mutex_lock(&own->lock);
+     int found = own->next < own->end;
+     if (found) {
+         *chunk = own->next++;
+     }
+     pthread_mutex_unlock(&own->lock);
+     while (!found) {
+         /* Pick the victim with the most work left; re-check under its lock */
+         int victim = -1;
+         uint64_t most = 0;
+         for (int t = 0; t < pool->threads; t++) {
+             WorkRange *r = &pool->ranges[t];
+             pthread_mutex_lock(&r->lock);
+             uint64_t left = r->end - r->next;
+             pthread_mutex_unlock(&r->lock);
+             if (left > most) {
+                 most = left;
+                 victim = t;
+             }
+         }
+         if (victim < 0) {
+             return 0;
+         }
+         WorkRange *r = &pool->ranges[victim];
+         pthread_mutex_lock(&r->lock);
+         if (r->next < r->end) {
+             *chunk = --r->end;
+             found = 1;
+         }
+         pthread_mutex_unlock(&r->lock);
+     }
+     return 1;
+ }
+ 
+ typedef struct {
+     TablePool *pool;
+     int self;
+     vword *stack;             /* scratch space for run_program_block */
+ } WorkerArg;
+ 
+ /* -------------------------------------------------------------------------
+  * table_worker:
+  *   Thread body: waits for a window, evaluates chunks until none are left,
+  *   reports completion and repeats until the pool is stopped.
+  * ------------------------------------------------------------------------- */
+ static void *table_worker(void *arg) {
+     TablePool *pool = ((WorkerArg *)arg)->pool;
+     int self = ((WorkerArg *)arg)->self;
+     vword *stack = ((WorkerArg *)arg)->stack;
+     size_t chunk_words = (size_t)pool->prog->outputs * CHUNK_WORDS;
+     uint64_t seen = 0;
+ 
+     pthread_mutex_lock(&pool->lock);
+     for (;;) {
+         while (pool->generation == seen && !pool->stop) {
+             pthread_cond_wait(&pool->work_ready, &pool->lock);
+         }
+         if (pool->stop) {
+             break;
+         }
+         seen = pool->generation;
+         uint64_t window_first = pool->window_first;
+         uint64_t *window_results = pool->window_results;
+         pthread_mutex_unlock(&pool->lock);
+ 
+         uint64_t chunk;
+         while (take_chunk(pool, self, &chunk)) {
+             uint64_t first_row = chunk * CHUNK_ROWS;
+             uint64_t count = pool->end_row - first_row;
+             if (count > CHUNK_ROWS) {
+                 count = CHUNK_ROWS;
+             }
+             evaluate_chunk(pool->prog, stack, first_row, count,
+                            window_results + (chunk - window_first) * chunk_words);
+         }
+ 
+         pthread_mutex_lock(&pool->lock);
+         if (--pool->pending == 0) {
+             pthread_cond_signal(&pool->work_done);
+         }
+     }
+     pthread_mutex_unlock(&pool->lock);
+     return NULL;
+ }
+ 
+ /* -------------------------------------------------------------------------
+  * publish_window:
+  *   Splits chunks [first, first + count) into contiguous per-worker ranges
+  *   and wakes the workers. Called with pool->lock held.
+  * ------------------------------------------------------------------------- */
+ static void publish_window(TablePool *pool, uint64_t first, uint64_t count,
+                            uint64_t *results) {
+     for (int t = 0; t < pool->threads; t++) {
+         WorkRange *r = &pool->ranges[t];
+         pthread_mutex_lock(&r->lock);
+         r->next = first + count * t / pool->threads;
+         r->end = first + count * (t + 1) / pool->threads;
+         pthread_mutex_unlock(&r->lock);
+     }
+     pool->window_first = first;
+     pool->window_results = results;
+     pool->pending = pool->threads;
+     pool->generation++;
+     pthread_cond_broadcast(&pool->work_ready);
+ }
+ 
+ /* -------------------------------------------------------------------------
+  * parallel_truth_table:
+  *   Evaluates every row of a program's truth table and passes the results
+  *   to 'callback' chunk by chunk, in row order, on the calling thread.
+  *
+  *   Parameters:
+  *     prog     - The compiled program.
+  *     threads  - Number of worker threads; 1 or less evaluates sequentially.
+  *     callback - Receives each chunk of results.
+  *     ctx      - Passed through to the callback.
+  *
+  *   Returns:
+  *     0 on success, -1 if memory or threads could not be obtained.
+  * ------------------------------------------------------------------------- */
+ int parallel_truth_table(const Program *prog, int threads, ChunkCallback callback,
+                          void *ctx) {
+     return parallel_truth_range(prog, threads, 0, 1ULL << prog->var_count, callback, ctx);
+ }
+
+ /* -------------------------------------------------------------------------
+  * parallel_truth_range:
+  *   Like parallel_truth_table, but evaluates only the 'count' rows starting
+  *   at 'first_row' (clipped to the table). Workers evaluate whole chunks of
+  *   the table's chunk grid; the first one is shifted to start at first_row
+  *   before it is handed to the callback.
+  *
+  *   Returns:
+  *     0 on success, -1 if memory or threads could not be obtained.
+  * ------------------------------------------------------------------------- */
+ int parallel_truth_range(const Program *prog, int threads, uint64_t first_row,
+                          uint64_t count, ChunkCallback callback, void *ctx) {
+     uint64_t total = 1ULL << prog->var_count;
+     uint64_t begin_row = first_row < total ? first_row : total;
+     uint64_t end_row = count < total - begin_row ? begin_row + count : total;
+     uint64_t first_chunk = begin_row / CHUNK_ROWS;
+     uint64_t end_chunk = (end_row + CHUNK_ROWS - 1) / CHUNK_ROWS;
+     uint64_t total_chunks = end_chunk - first_chunk;
+     if (total_chunks == 0) {
+         return 0;
+     }
+     if (threads < 1) {
+         threads = 1;
+     }
+     if (threads > MAX_THREADS) {
+         threads = MAX_THREADS;
+     }
+     if ((uint64_t)threads > total_chunks) {
+         threads = (int)total_chunks;
+     }
+
+     if (threads <= 1) {
+         RowEnumerator rows;
+         if (enumerator_init(&rows, prog) != 0) {
+             return -1;
+         }
+         enumerator_range(&rows, begin_row, end_row - begin_row);
+         uint64_t first, n;
+         while ((n = enumerator_next(&rows, &first)) > 0) {
+             callback(ctx, first, n, rows.results);
+         }
+         enumerator_free(&rows);
+         return 0;
+     }
+
+     TablePool pool;
+     memset(&pool, 0, sizeof(pool));
+     pool.prog = prog;
+     pool.end_row = end_row;
+     pool.threads = threads;
+     pthread_mutex_init(&pool.lock, NULL);
+     pthread_cond_init(&pool.work_ready, NULL);
+     pthread_cond_init(&pool.work_done, NULL);
+ 
+     uint64_t window = (uint64_t)threads * CHUNKS_PER_THREAD;
+     size_t chunk_words = (size_t)prog->outputs * CHUNK_WORDS;
+     uint64_t *buffers[2];
+     buffers[0] = malloc(window * chunk_words * sizeof(uint64_t));
+     buffers[1] = malloc(window * chunk_words * sizeof(uint64_t));
+     pool.ranges = calloc(threads, sizeof(WorkRange));
+     pthread_t tids[MAX_THREADS];
+     WorkerArg args[MAX_THREADS];
+     int started = 0;
+     int ranges_ready = 0;
+     int rc = (buffers[0] && buffers[1] && pool.ranges) ? 0 : -1;
+     size_t stack_size = (prog->max_depth + prog->slot_count + 1) * sizeof(vword);
+     for (int t = 0; t < threads; t++) {
+         args[t].stack = (rc == 0) ? aligned_alloc(sizeof(vword), stack_size) : NULL;
+         if (!args[t].stack) {
+             rc = -1;
+         }
+     }
+     if (rc == 0) {
+         for (int t = 0; t < threads; t++) {
+             pthread_mutex_init(&pool.ranges[t].lock, NULL);
+         }
+         ranges_ready = 1;
+         for (; started < threads; started++) {
+             args[started].pool = &pool;
+             args[started].self = started;
+             if (pthread_create(&tids[started], NULL, table_worker, &args[started]) != 0) {
+                 rc = -1;
+                 break;
+             }
+         }
+     }
+     if (rc == 0) {
+         pool.threads = started;
+         pthread_mutex_lock(&pool.lock);
+         publish_window(&pool, first_chunk, total_chunks < window ? total_chunks : window,
+                        buffers[0]);
+         for (uint64_t first = first_chunk, k = 0; first < end_chunk; first += window, k++) {
+             while (pool.pending > 0) {
+                 pthread_cond_wait(&pool.work_done, &pool.lock);
+             }
+             /* Start the next window before emitting this one */
+             uint64_t next = first + window;
+             if (next < end_chunk) {
+                 uint64_t left = end_chunk - next;
+                 publish_window(&pool, next, left < window ? left : window, buffers[(k + 1) & 1]);
+             }
+             pthread_mutex_unlock(&pool.lock);
+ 
+             uint64_t *results = buffers[k & 1];
+             for (uint64_t c = first; c < first + window && c < end_chunk; c++) {
+                 uint64_t chunk_row = c * CHUNK_ROWS;
+                 uint64_t n = end_row - chunk_row;
+                 if (n > CHUNK_ROWS) {
+                     n = CHUNK_ROWS;
+                 }
+                 uint64_t *chunk = results + (c - first) * chunk_words;
+                 if (begin_row > chunk_row) {
+                     for (int o = 0; o < prog->outputs; o++) {
+                         shift_results(chunk + o * CHUNK_WORDS, CHUNK_WORDS, begin_row - chunk_row);
+                     }
+                     n -= begin_row - chunk_row;
+                     chunk_row = begin_row;
+                 }
+                 callback(ctx, chunk_row, n, chunk);
+             }
+             pthread_mutex_lock(&pool.lock);
+         }
+         pthread_mutex_unlock(&pool.lock);
+     }
+ 
+     pthread_mutex_lock(&pool.lock);
+     pool.stop = 1;
+     pthread_cond_broadcast(&pool.work_ready);
+     pthread_mutex_unlock(&pool.lock);
+     for (int t = 0; t < started; t++) {
+         pthread_join(tids[t], NULL);
+     }
+     for (int t = 0; t < threads; t++) {
+         if (ranges_ready) {
+             pthread_mutex_destroy(&pool.ranges[t].lock);
+         }
+         free(args[t].stack);
+     }
+     pthread_cond_destroy(&pool.work_done);
+     pthread_cond_destroy(&pool.work_ready);
+     pthread_mutex_destroy(&pool.lock);
+     free(pool.ranges);
+     free(buffers[0]);
+     free(buffers[1]);
+     return rc;
+ }
+ 
+ /* State shared by the threads of find_counterexample */
+ typedef struct {
+     const Program *prog;
+     uint64_t end_row;         /* rows in the table */
+     pthread_mutex_t lock;     /* guards the fields below */
+     uint64_t next_chunk;      /* next chunk to hand out */
+     uint64_t found_chunk;     /* lowest chunk with a counterexample so far */
+     uint64_t found_row;       /* the first counterexample in it */
+     int error;
+ } Search;
+
+ /* -------------------------------------------------------------------------
+  * search_worker:
+  *   Thread body: takes chunks in increasing order until one with a
+  *   counterexample has been found below the next, looking for the first
+  *   row of each at which the program's outputs disagree.
+  * ------------------------------------------------------------------------- */
+ static void *search_worker(void *arg) {
+     Search *search = arg;
+     const Program *prog = search->prog;
+     vword *stack = aligned_alloc(sizeof(vword),
+                                  (prog->max_depth + prog->slot_count + 1) * sizeof(vword));
+     uint64_t *results = malloc((size_t)prog->outputs * CHUNK_WORDS * sizeof(uint64_t));
+     if (!stack || !results) {
+         pthread_mutex_lock(&search->lock);
+         search->error = 1;
+         pthread_mutex_unlock(&search->lock);
+         free(stack);
+         free(results);
+         return NULL;
+     }
+     for (;;) {
+         pthread_mutex_lock(&search->lock);
+         uint64_t chunk = search->next_chunk;
+         int done = search->error || chunk >= search->found_chunk
+                    || chunk * CHUNK_ROWS >= search->end_row;
+         search->next_chunk += !done;
+         pthread_mutex_unlock(&search->lock);
+         if (done) {
+             break;
+         }
+ 
+         uint64_t first_row = chunk * CHUNK_ROWS;
+         uint64_t count = search->end_row - first_row;
+         if (count > CHUNK_ROWS) {
+             count = CHUNK_ROWS;
+         }
+         evaluate_chunk(prog, stack, first_row, count, results);
+         for (uint64_t w = 0; w * 64 < count; w++) {
+             // Rows where the outputs differ, or the only output is false.
+             uint64_t diff = prog->outputs > 1 ? results[w] ^ results[CHUNK_WORDS + w]
+                                               : ~results[w];
+             if (count - w * 64 < 64) {
+                 diff &= (1ULL << (count - w * 64)) - 1;
+             }
+             if (diff) {
+                 pthread_mutex_lock(&search->lock);
+                 if (chunk < search->found_chunk) {
+                     search->found_chunk = chunk;
+                     search->found_row = first_row + w * 64 + (uint64_t)__builtin_ctzll(diff);
+                 }
+                 pthread_mutex_unlock(&search->lock);
+                 break;
+             }
+         }
+     }
+     free(stack);
+     free(results);
+     return NULL;
+ }
+
+ /* -------------------------------------------------------------------------
+  * find_counterexample:
+  *   Sweeps a program's truth table for the first row at which its first
+  *   output differs from its second, or for a program with a single output,
+  *   at which that is false. Chunks are handed out in row order to
+  *   'threads' threads, which stop taking more once one of them has found a
+  *   counterexample in an earlier chunk, so an equivalence or tautology that
+  *   does not hold usually costs a small part of the table.
+  *
+  *   Parameters:
+  *     prog    - The compiled program, with one or two outputs.
+  *     threads - Number of threads; 1 or less searches on the caller.
+  *     row     - Receives the first counterexample, if there is one.
+  *
+  *   Returns:
+  *     1 if a counterexample was found, 0 if there is none, -1 if memory
+  *     could not be allocated.
+  * ------------------------------------------------------------------------- */
+ int find_counterexample(const Program *prog, int threads, uint64_t *row) {
+     Search search;
+     search.prog = prog;
+     search.end_row = 1ULL << prog->var_count;
+     search.next_chunk = 0;
+     search.found_chunk = UINT64_MAX;
+     search.found_row = 0;
+     search.error = 0;
+     pthread_mutex_init(&search.lock, NULL);
+ 
+     uint64_t chunks = (search.end_row + CHUNK_ROWS - 1) / CHUNK_ROWS;
+     if (threads < 1) {
+         threads = 1;
+     }
+     if (threads > MAX_THREADS) {
+         threads = MAX_THREADS;
+     }
+     if ((uint64_t)threads > chunks) {
+         threads = (int)chunks;
+     }
+     // The caller searches too, and in place of any thread that did not start.
+     pthread_t tids[MAX_THREADS];
+     int started = 0;
+     for (; started < threads - 1; started++) {
+         if (pthread_create(&tids[started], NULL, search_worker, &search) != 0) {
+             break;
+         }
+     }
+     search_worker(&search);
+     for (int t = 0; t < started; t++) {
+         pthread_join(tids[t], NULL);
+     }
+     pthread_mutex_destroy(&search.lock);
+ 
+     if (search.found_chunk != UINT64_MAX) {
+         *row = search.found_row;
+         return 1;
+     }
+     return search.error ? -1 : 0;
+ }
+ 
+ /* -------------------------------------------------------------------------
+  * evaluate_with_assignments:
+  *   Evaluates a Boolean expression for explicit variable values. Variables
+  *   the list does not mention keep the default value, true (1).
+  *
+  *   Parameters:
+  *     expr        - The Boolean expression as a string.
+  *     assignments - An assignment list such as "A=0,B=1", or NULL.
+  *     result      - Receives the evaluated result (0 or 1).
+  *
+  *   Returns:
+  *     0 on success, -1 if the list is malformed, -2 if memory ran out.
+  * ------------------------------------------------------------------------- */
+ int evaluate_with_assignments(const char *expr, const char *assignments, int *result) {
+     Program prog;
+     if (compile_expression(expr, &prog) != 0) {
+         return -2;
+     }
+     Evaluator ev;
+     if (evaluator_init(&ev, &prog) != 0) {
+         free_program(&prog);
+         return -2;
+     }
+     ev.values = ~0ULL;
+     int rc = 0;
+     if (assignments && apply_assignments(&ev, assignments) != 0) {
+         rc = -1;
+     } else {
+         *result = evaluator_run(&ev);
+     }
+     evaluator_free(&ev);
+     free_program(&prog);
+     return rc;
+ }
+ 
+ /* -------------------------------------------------------------------------
+  * evaluate_boolean_expression:
+  *   Evaluates a Boolean expression using the default variable mapping,
+  *   which assumes all alphabetic variables are true (1).
+  *
+  *   Parameters:
+  *     expr - The Boolean expression as a string.
+  *
+  *   Returns:
+  *     The evaluated result (0 or 1).
+  * ------------------------------------------------------------------------- */
+ int evaluate_boolean_expression(const char *expr) {
+     int result = 0;
+     if (evaluate_with_assignments(expr, NULL, &result) != 0) {
+         fprintf(stderr, "Error: Out of memory.\n");
+     }
+     return result;
+ }
+ 
+ /* -------------------------------------------------------------------------
+  * evaluate_expr_with_mapping:
+  *   Evaluates a Boolean expression using a provided variable mapping.
+  *
+  *   Parameters:
+  *     expr    - The Boolean expression as a string.
+  *     mapping - An array of 256 ints mapping each character to its Boolean value.
+  *
+  *   Returns:
+  *     The evaluated result (0 or 1).
+  * ------------------------------------------------------------------------- */
+ int evaluate_expr_with_mapping(const char *expr, int mapping[256]) {
+     Program prog;
+     if (compile_expression(expr, &prog) != 0) {
+         fprintf(stderr, "Error: Out of memory.\n");
+         return 0;
+     }
+     Evaluator ev;
+     if (evaluator_init(&ev, &prog) != 0) {
+         fprintf(stderr, "Error: Out of memory.\n");
+         free_program(&prog);
+         return 0;
+     }
+     for (int j = 0; j < prog.var_count; j++) {
+         evaluator_set(&ev, prog.vars[j], mapping[(unsigned char)prog.vars[j]]);
+     }
+     int result = evaluator_run(&ev);
+     evaluator_free(&ev);
+     free_program(&prog);
+     return result;
+ }
+ 
+ /* -------------------------------------------------------------------------
+  * parse_format:
+  *   Maps a format name ("text", "html", "csv" or "bin") to its FORMAT_ value.
+  *
+  *   Returns:
+  *     The format, or -1 if the name is unknown.
+  * ------------------------------------------------------------------------- */
+ int parse_format(const char *name) {
+     static const char *names[] = { "text", "html", "csv", "bin" };
+     for (int i = 0; i < 4; i++) {
+         if (strcmp(name, names[i]) == 0) {
+             return i;
+         }
+     }
+     return -1;
+ }
+ 
+ /* -------------------------------------------------------------------------
+  * parse_filter:
+  *   Maps a filter name ("all", "true" or "false", or "1" and "0") to its
+  *   FILTER_ value.
+  *
+  *   Returns:
+  *     The filter, or -1 if the name is unknown.
+  * ------------------------------------------------------------------------- */
+ int parse_filter(const char *name) {
+     if (strcmp(name, "all") == 0) {
+         return FILTER_ALL;
+     }
+     if (strcmp(name, "true") == 0 || strcmp(name, "1") == 0) {
+         return FILTER_TRUE;
+     }
+     if (strcmp(name, "false") == 0 || strcmp(name, "0") == 0) {
+         return FILTER_FALSE;
+     }
+     return -1;
+ }
+
+ /* -------------------------------------------------------------------------
+  * writer_flush:
+  *   Sends the buffered output to the writer's destination.
+  * ------------------------------------------------------------------------- */
+ void writer_flush(TableWriter *w) {
+     size_t done = 0;
+     if (w->sink) {
+         done = w->len ? w->sink(w->sink_ctx, w->buf, w->len) : 0;
+     } else if (w->stream) {
+         done = fwrite(w->buf, 1, w->len, w->stream);
+     } else {
+         while (done < w->len) {
+             ssize_t n = write(w->fd, w->buf + done, w->len - done);
+             if (n < 0 && errno == EINTR) {
+                 continue;
+             }
+             if (n <= 0) {
+                 break;
+             }
+             done += n;
+         }
+     }
+     if (done < w->len) {
+         w->error = 1;
+     }
+     w->len = 0;
+ }
+ 
+ /* -------------------------------------------------------------------------
+  * writer_put:
+  *   Appends up to WRITER_BUFFER_SIZE bytes to the output buffer, flushing it
+  *   first if necessary.
+  * ------------------------------------------------------------------------- */
+ static void writer_put(TableWriter *w, const char *data, size_t len) {
+     if (w->len + len > WRITER_BUFFER_SIZE) {
+         writer_flush(w);
+     }
+     memcpy(w->buf + w->len, data, len);
+     w->len += len;
+ }
+ 
+ /* -------------------------------------------------------------------------
+  * writer_init:
+  *   Prepares a writer for the truth table of a program and writes the table
+  *   header. Output goes to 'stream' if it is not NULL, otherwise to 'fd'.
+  *
+  *   Parameters:
+  *     w      - The writer.
+  *     format - One of the FORMAT_ values.
+  *     prog   - The compiled program whose table is written.
+  *     fd     - Destination file descriptor, used when stream is NULL.
+  *     stream - Destination stream, or NULL.
+  *
+  *   Returns:
+  *     0 on success, -1 if memory could not be allocated or the binary
+  *     format is asked for a program with several outputs.
+  * ------------------------------------------------------------------------- */
+ int writer_init(TableWriter *w, int format, const Program *prog, int fd, FILE *stream) {
+     memset(w, 0, sizeof(*w));
+     if (format == FORMAT_BINARY && prog->outputs > 1) {
+         return -1;
+     }
+     w->format = format;
+     w->var_count = prog->var_count;
+     w->outputs = prog->outputs;
+     w->fd = fd;
+     w->stream = stream;
+     w->buf = malloc(WRITER_BUFFER_SIZE);
+     if (!w->buf) {
+         return -1;
+     }
+     if (!stream) {
+         // Anything already printed through stdio must come first.
+         fflush(stdout);
+     }
+ 
+     // Build the header and the template of row 0.
+     char header[MAX_ROW_LENGTH + 64 + 8 * MAX_OUTPUTS];
+     size_t n = 0;
+     int n_vars = prog->var_count;
+     int outputs = prog->outputs;
+     if (format == FORMAT_BINARY) {
+         uint64_t rows = 1ULL << n_vars;
+         memcpy(header, "BTT1", 4);
+         header[4] = (char)n_vars;
+         memcpy(header + 5, prog->vars, n_vars);
+         n = 5 + n_vars;
+         for (int i = 0; i < 8; i++) {
+             header[n++] = (char)(rows >> (8 * i));
+         }
+     } else if (format == FORMAT_HTML) {
+         n = (size_t)sprintf(header, "<table border='1' cellpadding='5' cellspacing='0'><tr>");
+         for (int j = 0; j < n_vars; j++) {
+             n += sprintf(header + n, "<th>%c</th>", prog->vars[j]);
+         }
+         if (outputs == 1) {
+             n += sprintf(header + n, "<th>Result</th>");
+         } else {
+             for (int o = 0; o < outputs; o++) {
+                 n += sprintf(header + n, "<th>Result %d</th>", o + 1);
+             }
+         }
+         n += sprintf(header + n, "</tr>");
+ 
+         w->row_len = (size_t)sprintf(w->row, "<tr>");
+         for (int j = 0; j < n_vars; j++) {
+             w->cell[j] = w->row_len + 4;
+             w->row_len += sprintf(w->row + w->row_len, "<td>0</td>");
+         }
+         for (int o = 0; o < outputs; o++) {
+             w->result_at[o] = w->row_len + 4;
+             w->row_len += sprintf(w->row + w->row_len, "<td>0</td>");
+         }
+         w->row_len += sprintf(w->row + w->row_len, "</tr>");
+     } else {
+         char sep = (format == FORMAT_CSV) ? ',' : '\t';
+         for (int j = 0; j < n_vars; j++) {
+             header[n++] = prog->vars[j];
+             header[n++] = sep;
+             w->cell[j] = 2 * j;
+             w->row[2 * j] = '0';
+             w->row[2 * j + 1] = sep;
+         }
+         if (outputs == 1) {
+             n += sprintf(header + n, "Result\n");
+         } else {
+             for (int o = 0; o < outputs; o++) {
+                 n += sprintf(header + n, "Result %d%c", o + 1, o + 1 < outputs ? sep : '\n');
+             }
+         }
+         for (int o = 0; o < outputs; o++) {
+             size_t at = 2 * ((size_t)n_vars + o);
+             w->result_at[o] = at;
+             w->row[at] = '0';
+             w->row[at + 1] = o + 1 < outputs ? sep : '\n';
+         }
+         w->row_len = 2 * ((size_t)n_vars + outputs);
+     }
+     writer_put(w, header, n);
+     return 0;
+ }
+ 
+ /* -------------------------------------------------------------------------
+  * writer_row:
+  *   Appends one row of a text format.
+  * ------------------------------------------------------------------------- */
+ static inline void writer_row(TableWriter *w, uint64_t row, int result) {
+     // Flip the digits of the variables whose value changed.
+     uint64_t changed = row ^ w->prev_row;
+     while (changed) {
+         int bit = __builtin_ctzll(changed);
+         changed &= changed - 1;
+         w->row[w->cell[w->var_count - bit - 1]] ^= 1;
+     }
+     w->prev_row = row;
+     w->row[w->result_at[0]] = (char)('0' + result);
+
+     if (w->len + w->row_len > WRITER_BUFFER_SIZE) {
+         writer_flush(w);
+     }
+     memcpy(w->buf + w->len, w->row, w->row_len);
+     w->len += w->row_len;
+ }
+
+ /* -------------------------------------------------------------------------
+  * writer_outputs:
+  *   Sets the result digits of every output but the first for bit k of a
+  *   chunk of results.
+  * ------------------------------------------------------------------------- */
+ static inline void writer_outputs(TableWriter *w, const uint64_t *results, uint64_t k) {
+     for (int o = 1; o < w->outputs; o++) {
+         unsigned bit = (results[o * CHUNK_WORDS + k / 64] >> (k % 64)) & 1;
+         w->row[w->result_at[o]] = (char)('0' + bit);
+     }
+ }
+
+ /* -------------------------------------------------------------------------
+  * writer_rows:
+  *   ChunkCallback that appends 'count' rows starting at 'first', or only
+  *   those the writer's filter keeps. Rows must arrive in order, which for a
+  *   writer with gray_order set is Gray-code order from position 'first';
+  *   the binary format additionally expects every row, in row order. For a
+  *   program with several outputs, the filter keeps the rows where any
+  *   output matches.
+  * ------------------------------------------------------------------------- */
+ void writer_rows(void *ctx, uint64_t first, uint64_t count, const uint64_t *results) {
+     TableWriter *w = ctx;
+     if (w->format == FORMAT_BINARY) {
+         char bytes[CHUNK_ROWS / 8];
+         size_t n = (size_t)((count + 7) / 8);
+         for (size_t i = 0; i < n; i++) {
+             bytes[i] = (char)(results[i / 8] >> (8 * (i % 8)));
+         }
+         if (count % 8) {
+             // Clear the bits past the last row.
+             bytes[n - 1] &= (char)((1 << (count % 8)) - 1);
+         }
+         writer_put(w, bytes, n);
+         return;
+     }
+ 
+     if (w->filter == FILTER_ALL) {
+         for (uint64_t k = 0; k < count; k++) {
+             uint64_t row = w->gray_order ? (first + k) ^ ((first + k) >> 1) : first + k;
+             if (w->outputs > 1) {
+                 writer_outputs(w, results, k);
+             }
+             writer_row(w, row, (results[k / 64] >> (k % 64)) & 1);
+         }
+         return;
+     }
+
+     // Visit only the rows where a result matches, a word at a time.
+     uint64_t invert = w->filter == FILTER_TRUE ? 0 : ~0ULL;
+     for (uint64_t word = 0; word * 64 < count; word++) {
+         uint64_t match = 0;
+         for (int o = 0; o < w->outputs; o++) {
+             match |= results[o * CHUNK_WORDS + word] ^ invert;
+         }
+         if (count - word * 64 < 64) {
+             match &= (1ULL << (count - word * 64)) - 1;
+         }
+         while (match) {
+             int bit = __builtin_ctzll(match);
+             match &= match - 1;
+             uint64_t row = first + word * 64 + (uint64_t)bit;
+             if (w->outputs > 1) {
+                 writer_outputs(w, results, word * 64 + (uint64_t)bit);
+             }
+             writer_row(w, w->gray_order ? row ^ (row >> 1) : row,
+                        (int)(results[word] >> bit) & 1);
+         }
+     }
+ }
+ 
+ /* -------------------------------------------------------------------------
+  * writer_finish:
+  *   Writes the table footer, flushes the buffer and releases the writer.
+  *
+  *   Returns:
+  *     0 on success, -1 if any output could not be written.
+  * ------------------------------------------------------------------------- */
+ int writer_finish(TableWriter *w) {
+     if (w->format == FORMAT_HTML) {
+         writer_put(w, "</table>", 8);
+     }
+     writer_flush(w);
+     free(w->buf);
+     w->buf = NULL;
+     return w->error ? -1 : 0;
+ }
\ No newline at end of file
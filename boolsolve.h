@@ -0,0 +1,416 @@
+/*
+ * boolsolve.h - Core library of the Boolean Expression Solver
+ *
+ * Declares the C API shared by the solver command-line tool and the
+ * server.cgi backend: compiling an expression into a Program, evaluating it
+ * for one assignment of its variables or for the recorded rows of a column
+ * file, enumerating, evaluating and writing its truth table on one or more
+ * threads, answering satisfiability,
+ * counting and equivalence queries with BDDs, and simplifying it to a
+ * minimal sum of products or product of sums.
+ *
+ * An expression uses '+' for OR, '·' (or '&', '*') for AND and '!' for NOT,
+ * with parentheses for grouping, the literals '0' and '1', and single-letter
+ * variables. Unrecognized characters are skipped.
+ *
+ * Build the library and both front ends with:
+ *   make
+ */
+
+ #ifndef BOOLSOLVE_H
+ #define BOOLSOLVE_H
+
+ #include <stdio.h>
+ #include <stdint.h>
+ 
+ /* -------------------------------------------------------------------------
+  * Compiled Program:
+  * An expression is parsed once into flat postfix bytecode, in which every
+  * distinct subterm is computed only once. Every variable is resolved to a
+  * dense slot (in order of first appearance), and an assignment
+  * of values is a bitmask in which slot j occupies bit (var_count - j - 1).
+  * With that layout, the row index of a truth table is its own assignment.
+  * A set of up to MAX_OUTPUTS expressions can also be compiled together
+  * into one program with an output per expression, sharing their variables
+  * and every subterm they have in common; a run leaves output o in stack
+  * entry o. Engines that take such a program produce a result for every
+  * output in one pass; the others use the first.
+  * ------------------------------------------------------------------------- */
+ #define MAX_VARS 64
+ #define MAX_OUTPUTS 64
+ 
+ enum {
+     OP_CONST,   /* push arg */
+     OP_VAR,     /* push bit 'arg' of the assignment */
+     OP_NOT,     /* replace top with its negation */
+     OP_AND,     /* pop two, push their conjunction */
+     OP_OR,      /* pop two, push their disjunction */
+     OP_STORE,   /* copy top into temporary 'arg', leaving it on the stack */
+     OP_LOAD     /* push temporary 'arg' */
+ };
+ 
+ typedef struct {
+     unsigned char op;
+     uint32_t arg;
+ } Instr;
+ 
+ typedef struct Dag Dag;
+ 
+ /* An evaluation needs max_depth + slot_count entries of scratch space: the
+  * stack, followed by the temporaries of subterms that are used repeatedly. */
+ typedef struct {
+     Instr *code;
+     int length;
+     int capacity;             /* instructions allocated in code */
+     int max_depth;            /* deepest evaluation stack the code needs */
+     int slot_count;           /* temporaries used by OP_STORE and OP_LOAD */
+     int var_count;
+     char vars[MAX_VARS];
+     int outputs;              /* results left on the stack, 1 for an expression */
+     Dag *dag;                 /* compiler scratch, reused when recompiling */
+ } Program;
+
+ /* -------------------------------------------------------------------------
+  * Evaluator:
+  * A compiled Program is never modified after compile_expression returns, so
+  * any number of threads may share one. All mutable state of an evaluation
+  * lives in an Evaluator: the variable values (one bit per slot, as above)
+  * and the value stack.
+  * ------------------------------------------------------------------------- */
+ typedef struct {
+     const Program *prog;
+     uint64_t values;          /* variable values, one bit per slot */
+     unsigned char *stack;     /* max_depth + slot_count entries */
+     int stack_capacity;
+     unsigned char small_stack[64];
+ } Evaluator;
+ 
+ /* -------------------------------------------------------------------------
+  * Kernel:
+  * Evaluates a program for 64 assignments at once, given as bitslices: one
+  * word per assignment bit, in which bit k of slices[b] is bit b of the k-th
+  * assignment; bit k of the result is the value for that assignment. A
+  * kernel starts by interpreting the program over words. Once it has run
+  * long enough to pay for the translation (KERNEL_NATIVE_WORK instructions
+  * interpreted), it lowers the program to x86-64 machine code, keeping the
+  * evaluation stack in registers, and calls that from then on. Elsewhere,
+  * or if executable memory cannot be had, it goes on interpreting. Like an
+  * Evaluator, a kernel belongs to one thread. Outputs after the first are
+  * left in the kernel's scratch words.
+  * ------------------------------------------------------------------------- */
+ #define KERNEL_NATIVE_WORK (1 << 16)
+
+ typedef uint64_t (*KernelFunction)(const uint64_t *slices, uint64_t *scratch);
+
+ typedef struct {
+     const Program *prog;
+     KernelFunction native;    /* the machine code, NULL while interpreting */
+     void *code;               /* executable mapping holding it */
+     size_t code_size;
+     uint64_t budget;          /* runs left before translating, 0 for never */
+     uint64_t *scratch;        /* max_depth + slot_count words */
+ } Kernel;
+
+ /* -------------------------------------------------------------------------
+  * Bitsliced Evaluation:
+  * A block is BLOCK_ROWS consecutive truth-table rows, stored one bit per row
+  * in BLOCK_WORDS 64-bit words (row first_row + k lives in bit k % 64 of word
+  * k / 64). Every variable is then a fixed pattern of 0s and 1s across the
+  * block, and each '+', '·' and '!' becomes a single OR, AND or NOT over a
+  * vector of words.
+  * ------------------------------------------------------------------------- */
+ #define BLOCK_WORDS 8
+ #define BLOCK_ROWS (BLOCK_WORDS * 64)
+ 
+ typedef uint64_t vword __attribute__((vector_size(BLOCK_WORDS * sizeof(uint64_t))));
+ 
+ /* -------------------------------------------------------------------------
+  * Row Enumerator:
+  * Walks the rows of a truth table in chunks of CHUNK_ROWS rows, evaluating
+  * each chunk with the bitsliced kernel. Rows are counted in 64 bits and only
+  * one chunk of results is held at a time, so memory use does not depend on
+  * the number of rows and output can be written as each chunk completes.
+  * The walk may also be limited to any range of rows, such as one page of a
+  * table; only that range is evaluated.
+  * ------------------------------------------------------------------------- */
+ #define CHUNK_BLOCKS 16
+ #define CHUNK_ROWS (CHUNK_BLOCKS * BLOCK_ROWS)
+ 
+ typedef struct {
+     const Program *prog;
+     vword *stack;             /* scratch space for run_program_block */
+     uint64_t next_row;        /* first row of the next chunk */
+     uint64_t end_row;         /* one past the last row, 2^var_count by default */
+     uint64_t *results;        /* CHUNK_WORDS per output, bit k: row first + k */
+ } RowEnumerator;
+ 
+ /* -------------------------------------------------------------------------
+  * Gray-Code Enumerator:
+  * An alternative to the Row Enumerator for very wide expressions, in which
+  * each variable is used by only a few subterms. It keeps the value of every
+  * subterm over one word of 64 rows, the six lowest row bits bitsliced as in
+  * a block, and visits the words in Gray-code order: from one word to the
+  * next exactly one of the other variables flips, and only the subterms
+  * that depend on it, listed per variable in evaluation order, are computed
+  * again. Each chunk of results is re-sorted into row order, or with
+  * gray_order set is left in Gray-code order, in which bit k of a chunk at
+  * position p holds row gray(p + k), gray(i) = i ^ (i >> 1), and every row
+  * differs from the one before it in exactly one variable. It takes
+  * programs with a single output.
+  * ------------------------------------------------------------------------- */
+ typedef struct GrayNode GrayNode;
+
+ typedef struct {
+     const Program *prog;
+     int gray_order;           /* results in Gray-code order, not row order */
+     GrayNode *nodes;          /* the program's subterms, operands first */
+     int node_count;
+     int root;
+     uint64_t *values;         /* every node's value over the current word */
+     int *deps;                /* nodes depending on each row bit, in order */
+     int dep_start[MAX_VARS + 1];  /* row bit b: deps[dep_start[b]..dep_start[b + 1]) */
+     uint64_t word;            /* word of the table the values belong to */
+     uint64_t next;            /* position of the next chunk */
+     uint64_t end;             /* one past the last position, 2^var_count */
+     uint64_t results[CHUNK_BLOCKS * BLOCK_WORDS];  /* bit k: position next + k */
+ } GrayEnumerator;
+
+ /* -------------------------------------------------------------------------
+  * Parallel Truth Tables:
+  * The chunks of a table are evaluated by a pool of worker threads, one
+  * window of CHUNKS_PER_THREAD chunks per thread at a time. Each worker starts
+  * with a contiguous range of the window and, once its own range is empty,
+  * steals chunks from the back of the busiest other range. While the workers
+  * compute the next window, the calling thread hands the finished one to the
+  * output callback in row order, so results are merged without reordering
+  * and memory stays bounded by two windows. A search for a counterexample
+  * to an equivalence or tautology hands out chunks the same way, in row
+  * order, but stops as soon as one is found.
+  * ------------------------------------------------------------------------- */
+ #define CHUNK_WORDS (CHUNK_BLOCKS * BLOCK_WORDS)
+ #define MAX_THREADS 256
+ 
+ /* Receives 'count' results starting at 'first_row', bit k for row first_row + k;
+  * for a program with several outputs, output o's follow at results + o * CHUNK_WORDS */
+ typedef void (*ChunkCallback)(void *ctx, uint64_t first_row, uint64_t count,
+                               const uint64_t *results);
+ 
+ /* -------------------------------------------------------------------------
+  * Table Writer:
+  * Formats truth-table rows into a large buffer and hands it to write(2) (or
+  * fwrite for a stream) whenever it fills up. Every row of a table has the
+  * same fixed width, so the writer keeps the previous row pre-formatted and
+  * only flips the digits of the variables that changed, which is about two
+  * per row. The binary format is a packed result bitmap:
+  *   "BTT1", var_count (1 byte), variable names (var_count bytes),
+  *   row count (8 bytes, little-endian), then one bit per row, LSB first.
+  * A filter restricts the text formats to the rows whose result is 1 (or 0);
+  * those are found with a bit scan over each word of results, so skipped
+  * rows cost nothing. The binary format always holds every row.
+  * A sink, if set after writer_init, receives each flushed buffer in place of
+  * the fd or stream and returns how much it took, like fwrite; this lets a
+  * caller frame the output as it is produced.
+  * With gray_order set, the text formats take results from a Gray-Code
+  * Enumerator in Gray-code order; the binary format always takes row order.
+  * The text formats of a program with several outputs have a result column
+  * for each, and a filter keeps the rows where any of them matches; the
+  * binary format holds a single output, so writer_init refuses it for such
+  * a program.
+  * ------------------------------------------------------------------------- */
+ enum { FORMAT_TEXT, FORMAT_HTML, FORMAT_CSV, FORMAT_BINARY };
+ enum { FILTER_ALL, FILTER_TRUE, FILTER_FALSE };
+ 
+ #define WRITER_BUFFER_SIZE (1 << 20)
+ #define MAX_ROW_LENGTH (16 + 10 * (MAX_VARS + MAX_OUTPUTS))
+ 
+ typedef struct {
+     int format;
+     int filter;               /* FILTER_ value, FILTER_ALL after writer_init */
+     int var_count;
+     int fd;                   /* destination when stream is NULL */
+     FILE *stream;
+     size_t (*sink)(void *ctx, const char *data, size_t len);  /* NULL by default */
+     void *sink_ctx;
+     char *buf;
+     size_t len;
+     char row[MAX_ROW_LENGTH]; /* the previous row, fully formatted */
+     size_t row_len;
+     size_t cell[MAX_VARS];    /* offset of each variable's digit in row */
+     int outputs;
+     size_t result_at[MAX_OUTPUTS];  /* offset of each output's digit in row */
+     uint64_t prev_row;
+     int gray_order;           /* text rows arrive in Gray-code order */
+     int error;
+ } TableWriter;
+ 
+ /* -------------------------------------------------------------------------
+  * Binary Decision Diagrams:
+  * A reduced ordered BDD stores a function as a DAG of decisions on one
+  * variable each, always tested in the same order (by level), in which no
+  * two nodes are equal; equal functions are then the same node. Nodes live
+  * in a pool and are referred to by index, 0 and 1 being the constants, and
+  * a unique table finds existing nodes while a lossy cache remembers the
+  * results of recent operations. Satisfiability, model counting and
+  * equivalence take time in the size of the diagram, not 2^var_count.
+  * Equivalence and tautology checks over at most SWEEP_MAX_VARS variables
+  * sweep the truth table instead, stopping at the first counterexample,
+  * and leave the BDD for wider expressions.
+  * ------------------------------------------------------------------------- */
+ #define BDD_FALSE 0
+ #define BDD_TRUE 1
+ #define BDD_MAX_NODES (1 << 22)
+ #define SWEEP_MAX_VARS 24
+
+ enum { BDD_AND, BDD_OR, BDD_XOR };
+
+ typedef struct {
+     int level;                /* variable tested; var_count for constants */
+     int low, high;            /* successors when it is 0 and when it is 1 */
+ } BddNode;
+
+ typedef struct {
+     int op, f, g, result;
+ } BddCacheEntry;
+
+ typedef struct {
+     int var_count;
+     BddNode *nodes;           /* children always precede their parents */
+     int count;
+     int capacity;
+     int max_nodes;            /* operations fail beyond this many nodes */
+     int *unique;              /* open-addressed index of nodes, -1 if empty */
+     int unique_size;          /* power of two, at least 2 * capacity */
+     BddCacheEntry *cache;     /* direct-mapped operation results */
+     int cache_size;           /* power of two */
+     int error;                /* memory or max_nodes ran out */
+ } Bdd;
+
+ /* The answer to a satisfiability, counting or equivalence query */
+ typedef struct {
+     int var_count;
+     char vars[MAX_VARS];      /* variables of both expressions, by level */
+     int found;                /* some assignment satisfies (or tells apart) */
+     uint64_t model;           /* one such assignment, laid out as a row */
+     int value;                /* the first expression's value at model */
+     uint64_t count;           /* number of such assignments */
+     int counted;              /* count is known; a sweep stops at the first */
+     int nodes;                /* BDD nodes created */
+ } BddResult;
+
+ /* -------------------------------------------------------------------------
+  * Two-Level Minimization:
+  * A cube is a product of literals, stored as two words over the bits of a
+  * truth-table row: 'mask' has the bit of every variable the product uses
+  * and 'bits' the values it requires, so it contains row r exactly when
+  * (r & mask) == bits, and comparing, merging or testing cubes takes a few
+  * word operations. A cover is a sum of cubes. Functions of up to
+  * MINIMIZE_MAX_VARS variables are minimized with Espresso-style
+  * heuristics; for up to QM_MAX_VARS, a Quine-McCluskey search over all
+  * prime implicants then looks for a cheaper cover.
+  * ------------------------------------------------------------------------- */
+ #define QM_MAX_VARS 12
+ #define MINIMIZE_MAX_VARS 20
+
+ typedef struct {
+     uint64_t mask;            /* variables the product uses */
+     uint64_t bits;            /* their values, a subset of mask */
+ } Cube;
+
+ typedef struct {
+     Cube *cubes;
+     int count;
+     int capacity;
+     int var_count;
+     char vars[MAX_VARS];      /* variable names, as in the Program */
+ } Cover;
+
+ /* -------------------------------------------------------------------------
+  * Column Files:
+  * Recorded assignments, one row of variable values per event, stored as
+  * one packed bit column per variable so that they can be evaluated
+  * without parsing:
+  *   "BCL1", column count (1 byte), column names (1 byte each), zero
+  *   padding to a multiple of 8 bytes, row count (8 bytes, little-endian),
+  *   then every column as (rows + 63) / 64 little-endian 64-bit words,
+  *   row r in bit r % 64 of word r / 64.
+  * The file is memory-mapped and its words are exactly the bitslices a
+  * Kernel takes, so a program is evaluated over 64 rows per kernel run,
+  * on as many threads as asked, at close to memory bandwidth. The results
+  * form one more packed column, stored in little-endian words like the
+  * columns, so that they can be written out as they are.
+  * ------------------------------------------------------------------------- */
+ typedef struct {
+     int count;                /* columns */
+     char names[MAX_VARS];
+     uint64_t rows;
+     uint64_t words;           /* words per column, (rows + 63) / 64 */
+     const uint64_t *columns[MAX_VARS];
+     void *map;                /* the mapped file */
+     size_t map_size;
+ } ColumnFile;
+
+ /* -------------------------------------------------------------------------
+  * Library API
+  * ------------------------------------------------------------------------- */
+ int compile_expression(const char *expr, Program *prog);
+ int recompile_expression(const char *expr, Program *prog);
+ int compile_expressions(const char *const *exprs, int count, Program *prog);
+ int recompile_expressions(const char *const *exprs, int count, Program *prog);
+ void free_program(Program *prog);
+ int optimize_program(Program *prog);
+ int evaluator_init(Evaluator *ev, const Program *prog);
+ int evaluator_bind(Evaluator *ev, const Program *prog);
+ int apply_assignments(Evaluator *ev, const char *list);
+ void evaluator_set(Evaluator *ev, char var, int value);
+ int evaluator_run(Evaluator *ev);
+ void evaluator_free(Evaluator *ev);
+ int kernel_init(Kernel *k, const Program *prog);
+ int kernel_compile(Kernel *k);
+ uint64_t kernel_run(Kernel *k, const uint64_t *slices);
+ void kernel_free(Kernel *k);
+ void run_program_block(const Program *prog, uint64_t first_row,
+                        vword *stack, uint64_t *out, size_t stride);
+ int enumerator_init(RowEnumerator *e, const Program *prog);
+ uint64_t enumerator_next(RowEnumerator *e, uint64_t *first_row);
+ void enumerator_range(RowEnumerator *e, uint64_t first_row, uint64_t count);
+ void enumerator_free(RowEnumerator *e);
+ int gray_init(GrayEnumerator *g, const Program *prog, int gray_order);
+ uint64_t gray_next(GrayEnumerator *g, uint64_t *first);
+ void gray_free(GrayEnumerator *g);
+ int gray_truth_table(const Program *prog, int gray_order, ChunkCallback callback,
+                      void *ctx);
+ int parallel_truth_table(const Program *prog, int threads, ChunkCallback callback,
+                          void *ctx);
+ int parallel_truth_range(const Program *prog, int threads, uint64_t first_row,
+                          uint64_t count, ChunkCallback callback, void *ctx);
+ int find_counterexample(const Program *prog, int threads, uint64_t *row);
+ int evaluate_with_assignments(const char *expr, const char *assignments, int *result);
+ int evaluate_boolean_expression(const char *expr);
+ int evaluate_expr_with_mapping(const char *expr, int mapping[256]);
+ int parse_format(const char *name);
+ int parse_filter(const char *name);
+ int writer_init(TableWriter *w, int format, const Program *prog, int fd, FILE *stream);
+ void writer_rows(void *ctx, uint64_t first, uint64_t count, const uint64_t *results);
+ void writer_flush(TableWriter *w);
+ int writer_finish(TableWriter *w);
+ int bdd_init(Bdd *bdd, int var_count);
+ void bdd_free(Bdd *bdd);
+ int bdd_var(Bdd *bdd, int level);
+ int bdd_apply(Bdd *bdd, int op, int f, int g);
+ int bdd_not(Bdd *bdd, int f);
+ int bdd_from_program(Bdd *bdd, const Program *prog, const int *levels);
+ int bdd_count(const Bdd *bdd, int f, uint64_t *count);
+ uint64_t bdd_satisfy(const Bdd *bdd, int f);
+ int bdd_evaluate(const Bdd *bdd, int f, uint64_t assignment);
+ int bdd_analyze(const char *expr, const char *expr2, BddResult *result);
+ int check_equivalence(const char *expr, const char *expr2, int threads, BddResult *result);
+ int minimize_program(const Program *prog, int threads, Cover *sop, Cover *pos);
+ void write_cover(const Cover *cover, int product_of_sums, FILE *out);
+ void free_cover(Cover *cover);
+ int column_open(ColumnFile *f, const char *path);
+ int column_find(const ColumnFile *f, char name);
+ int evaluate_columns(const Program *prog, const ColumnFile *f, int threads,
+                      uint64_t first_word, uint64_t words, uint64_t *results);
+ void column_close(ColumnFile *f);
+ 
+ #endif /* BOOLSOLVE_H */
\ No newline at end of file
@@ -0,0 +1,250 @@
+/*
+ * columns.c - Column files for the Boolean Expression Solver
+ *
+ * Implements the column file functions declared in boolsolve.h. A file is
+ * mapped read-only and checked once when it is opened; evaluation then
+ * reads the bitslices of 64 rows straight from the mapping, one word per
+ * variable, and hands them to a Kernel. The rows of a call are split
+ * evenly between the threads, each with its own kernel, which is
+ * translated to machine code up front when its share is large enough.
+ */
+
+ #include "boolsolve.h"
+
+ #include <stdlib.h>
+ #include <string.h>
+ #include <fcntl.h>
+ #include <unistd.h>
+ #include <pthread.h>
+ #include <sys/mman.h>
+ #include <sys/stat.h>
+
+ /* The part of an evaluate_columns call run by one thread */
+ typedef struct {
+     const Program *prog;
+     const uint64_t *columns[MAX_VARS];  /* column of each assignment bit */
+     uint64_t first_word;
+     uint64_t words;
+     uint64_t *results;
+     uint64_t stride;          /* words from one output's results to the next */
+     int rc;
+ } ColumnTask;
+
+ /* -------------------------------------------------------------------------
+  * le64:
+  *   Converts a little-endian word of the file to host order and back.
+  * ------------------------------------------------------------------------- */
+ static inline uint64_t le64(uint64_t x) {
+ #if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+     return __builtin_bswap64(x);
+ #else
+     return x;
+ #endif
+ }
+
+ /* -------------------------------------------------------------------------
+  * column_open:
+  *   Maps a column file and checks its header and size.
+  *
+  *   Parameters:
+  *     f    - Receives the file; release it with column_close.
+  *     path - The file to map.
+  *
+  *   Returns:
+  *     0 on success, -1 if the file cannot be opened or mapped (errno tells
+  *     why), -2 if it is not a well-formed column file.
+  * ------------------------------------------------------------------------- */
+ int column_open(ColumnFile *f, const char *path) {
+     memset(f, 0, sizeof(*f));
+     int fd = open(path, O_RDONLY);
+     if (fd < 0) {
+         return -1;
+     }
+     struct stat st;
+     if (fstat(fd, &st) != 0) {
+         close(fd);
+         return -1;
+     }
+     size_t size = (size_t)st.st_size;
+     if (size < 16) {
+         close(fd);
+         return -2;
+     }
+     void *map = mmap(NULL, size, PROT_READ, MAP_PRIVATE, fd, 0);
+     close(fd);
+     if (map == MAP_FAILED) {
+         return -1;
+     }
+     madvise(map, size, MADV_SEQUENTIAL);
+     f->map = map;
+     f->map_size = size;
+
+     const unsigned char *data = map;
+     int count = data[4];
+     size_t header = (5 + (size_t)count + 7) / 8 * 8;
+     if (memcmp(data, "BCL1", 4) != 0 || count > MAX_VARS || header + 8 > size) {
+         column_close(f);
+         return -2;
+     }
+     uint64_t rows = 0;
+     for (int i = 0; i < 8; i++) {
+         rows |= (uint64_t)data[header + i] << (8 * i);
+     }
+     uint64_t words = rows / 64 + (rows % 64 != 0);
+     size_t body = (size - header - 8) / 8;
+     if (count > 0 && words > body / (size_t)count) {
+         column_close(f);
+         return -2;
+     }
+     f->count = count;
+     memcpy(f->names, data + 5, (size_t)count);
+     f->rows = rows;
+     f->words = words;
+     // The header is padded so that every column is aligned.
+     for (int c = 0; c < count; c++) {
+         f->columns[c] = (const uint64_t *)(data + header + 8) + (size_t)c * words;
+     }
+     return 0;
+ }
+
+ /* -------------------------------------------------------------------------
+  * column_find:
+  *   Returns the index of the column named 'name', or -1 if there is none.
+  * ------------------------------------------------------------------------- */
+ int column_find(const ColumnFile *f, char name) {
+     for (int c = 0; c < f->count; c++) {
+         if (f->names[c] == name) {
+             return c;
+         }
+     }
+     return -1;
+ }
+
+ /* -------------------------------------------------------------------------
+  * column_worker:
+  *   Thread body: evaluates one task's words with a kernel of its own.
+  * ------------------------------------------------------------------------- */
+ static void *column_worker(void *arg) {
+     ColumnTask *t = arg;
+     Kernel k;
+     if (kernel_init(&k, t->prog) != 0) {
+         t->rc = -1;
+         return NULL;
+     }
+     if ((uint64_t)t->prog->length * t->words >= KERNEL_NATIVE_WORK) {
+         kernel_compile(&k);
+     }
+     int n = t->prog->var_count;
+     uint64_t slices[MAX_VARS];
+     for (uint64_t w = 0; w < t->words; w++) {
+         for (int b = 0; b < n; b++) {
+             slices[b] = le64(t->columns[b][t->first_word + w]);
+         }
+         t->results[w] = le64(kernel_run(&k, slices));
+         for (int o = 1; o < t->prog->outputs; o++) {
+             t->results[o * t->stride + w] = le64(k.scratch[o]);
+         }
+     }
+     kernel_free(&k);
+     t->rc = 0;
+     return NULL;
+ }
+
+ /* -------------------------------------------------------------------------
+  * evaluate_columns:
+  *   Evaluates a program for the rows of a column file, 64 per word, each
+  *   variable taking its value from the column of the same name.
+  *
+  *   Parameters:
+  *     prog       - The compiled program.
+  *     f          - The column file.
+  *     threads    - Number of threads; 1 or less evaluates on the caller.
+  *     first_word - First word of the columns to evaluate.
+  *     words      - Number of words to evaluate.
+  *     results    - Receives 'words' little-endian words, bit k of word i
+  *                  for row 64 * (first_word + i) + k; bits past the last
+  *                  row of the file are 0. A program with several outputs
+  *                  needs 'words' words for each, output o's starting at
+  *                  results + o * words.
+  *
+  *   Returns:
+  *     0 on success, -1 if memory ran out, -2 if a variable has no column
+  *     or the words are not all in the file.
+  * ------------------------------------------------------------------------- */
+ int evaluate_columns(const Program *prog, const ColumnFile *f, int threads,
+                      uint64_t first_word, uint64_t words, uint64_t *results) {
+     if (first_word > f->words || words > f->words - first_word) {
+         return -2;
+     }
+     ColumnTask base;
+     base.prog = prog;
+     base.stride = words;
+     for (int j = 0; j < prog->var_count; j++) {
+         int c = column_find(f, prog->vars[j]);
+         if (c < 0) {
+             return -2;
+         }
+         base.columns[prog->var_count - j - 1] = f->columns[c];
+     }
+
+     if (threads < 1) {
+         threads = 1;
+     }
+     if (threads > MAX_THREADS) {
+         threads = MAX_THREADS;
+     }
+     if ((uint64_t)threads > words) {
+         threads = words > 0 ? (int)words : 1;
+     }
+     ColumnTask *tasks = malloc((size_t)threads * sizeof(ColumnTask));
+     if (!tasks) {
+         return -1;
+     }
+     pthread_t ids[MAX_THREADS];
+     int started[MAX_THREADS] = {0};
+     for (int t = 0; t < threads; t++) {
+         tasks[t] = base;
+         uint64_t from = words * (uint64_t)t / (uint64_t)threads;
+         uint64_t to = words * (uint64_t)(t + 1) / (uint64_t)threads;
+         tasks[t].first_word = first_word + from;
+         tasks[t].words = to - from;
+         tasks[t].results = results + from;
+         tasks[t].rc = -1;
+     }
+     // The caller takes the first part, and any part without a thread.
+     for (int t = 1; t < threads; t++) {
+         started[t] = pthread_create(&ids[t], NULL, column_worker, &tasks[t]) == 0;
+     }
+     column_worker(&tasks[0]);
+     int rc = tasks[0].rc;
+     for (int t = 1; t < threads; t++) {
+         if (started[t]) {
+             pthread_join(ids[t], NULL);
+         } else {
+             column_worker(&tasks[t]);
+         }
+         if (tasks[t].rc != 0) {
+             rc = -1;
+         }
+     }
+     free(tasks);
+
+     if (rc == 0 && words > 0 && first_word + words == f->words && f->rows % 64) {
+         for (int o = 0; o < prog->outputs; o++) {
+             results[o * words + words - 1] &= le64((1ULL << (f->rows % 64)) - 1);
+         }
+     }
+     return rc;
+ }
+
+ /* -------------------------------------------------------------------------
+  * column_close:
+  *   Unmaps a column file.
+  * ------------------------------------------------------------------------- */
+ void column_close(ColumnFile *f) {
+     if (f->map) {
+         munmap(f->map, f->map_size);
+     }
+     f->map = NULL;
+     f->count = 0;
+ }
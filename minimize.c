@@ -0,0 +1,712 @@
+/*
+ * minimize.c - Two-level minimization for the Boolean Expression Solver
+ *
+ * Implements the minimizer declared in boolsolve.h. The truth table of a
+ * program is computed with the bitsliced engine into a bitmap, one bit per
+ * row, and every question about a cube (is it inside the function, which
+ * rows does it cover) is answered a 64-row word at a time from that bitmap.
+ * Every function is first minimized with Espresso-style expand, irredundant
+ * and reduce passes; for small ones, the Quine-McCluskey prime implicants
+ * and a bitset covering table then search for a minimum cover.
+ */
+
+ #include "boolsolve.h"
+
+ #include <stdlib.h>
+ #include <string.h>
+
+ #define QM_MAX_PRIMES 2048
+ #define QM_MAX_BRANCHES 200000
+ #define ESPRESSO_ROUNDS 4
+
+ /* The rows of a word in which bit i of the row index is set, for i < 6 */
+ static const uint64_t row_bit_pattern[6] = {
+     0xAAAAAAAAAAAAAAAAULL, 0xCCCCCCCCCCCCCCCCULL, 0xF0F0F0F0F0F0F0F0ULL,
+     0xFF00FF00FF00FF00ULL, 0xFFFF0000FFFF0000ULL, 0xFFFFFFFF00000000ULL
+ };
+
+ /* A truth table as a bitmap, with the scratch space of the minimizers */
+ typedef struct {
+     int var_count;
+     uint64_t all;             /* mask of every variable bit */
+     uint64_t *on;             /* bit r: the function is 1 in row r */
+     size_t words;
+     uint64_t valid;           /* rows of a word that exist */
+     uint32_t *counts;         /* cubes of the cover containing each row */
+ } Table;
+
+ /* -------------------------------------------------------------------------
+  * cube_literals:
+  *   Returns the number of literals of a cube.
+  * ------------------------------------------------------------------------- */
+ static int cube_literals(Cube c) {
+     return __builtin_popcountll(c.mask);
+ }
+
+ /* -------------------------------------------------------------------------
+  * cover_push:
+  *   Appends a cube to a cover, growing it as needed.
+  *
+  *   Returns:
+  *     0 on success, -1 if memory ran out.
+  * ------------------------------------------------------------------------- */
+ static int cover_push(Cover *cover, Cube c) {
+     if (cover->count == cover->capacity) {
+         int capacity = cover->capacity ? cover->capacity * 2 : 16;
+         Cube *cubes = realloc(cover->cubes, (size_t)capacity * sizeof(Cube));
+         if (!cubes) {
+             return -1;
+         }
+         cover->cubes = cubes;
+         cover->capacity = capacity;
+     }
+     cover->cubes[cover->count++] = c;
+     return 0;
+ }
+
+ /* -------------------------------------------------------------------------
+  * cover_cost:
+  *   Ranks covers by their number of products, then their literals.
+  * ------------------------------------------------------------------------- */
+ static uint64_t cover_cost(const Cube *cubes, int count) {
+     uint64_t literals = 0;
+     for (int i = 0; i < count; i++) {
+         literals += (uint64_t)cube_literals(cubes[i]);
+     }
+     return ((uint64_t)count << 32) | literals;
+ }
+
+ /* -------------------------------------------------------------------------
+  * Word-parallel cube access:
+  * The rows of cube c are those in which (row & c.mask) == c.bits. The six
+  * low bits of a row select its bit in a word and the rest select the word,
+  * so a cube is a single 64-bit pattern repeated over every word whose index
+  * agrees with the cube's high bits. cube_pattern builds that pattern, and
+  * CUBE_WORDS walks the matching words by enumerating the subsets of the
+  * cube's free high bits.
+  * ------------------------------------------------------------------------- */
+ static uint64_t cube_pattern(const Table *t, Cube c) {
+     uint64_t pattern = t->valid;
+     for (int i = 0; i < 6 && i < t->var_count; i++) {
+         if (c.mask >> i & 1) {
+             pattern &= (c.bits >> i & 1) ? row_bit_pattern[i] : ~row_bit_pattern[i];
+         }
+     }
+     return pattern;
+ }
+
+ #define CUBE_WORDS(t, c, w)                                                  \
+     for (uint64_t free_ = ((t)->all & ~(c).mask) >> 6, sub_ = 0, done_ = 0,  \
+          w = (c).bits >> 6; !done_;                                          \
+          sub_ = (sub_ - free_) & free_, done_ = sub_ == 0,                   \
+          w = ((c).bits >> 6) | sub_)
+
+ /* -------------------------------------------------------------------------
+  * cube_implies:
+  *   Tells whether the function is 1 in every row of cube 'c'.
+  * ------------------------------------------------------------------------- */
+ static int cube_implies(const Table *t, Cube c) {
+     uint64_t pattern = cube_pattern(t, c);
+     CUBE_WORDS(t, c, w) {
+         if ((t->on[w] & pattern) != pattern) {
+             return 0;
+         }
+     }
+     return 1;
+ }
+
+ /* -------------------------------------------------------------------------
+  * cube_count_rows:
+  *   Adds 'delta' to the cover count of every row of cube 'c'.
+  * ------------------------------------------------------------------------- */
+ static void cube_count_rows(Table *t, Cube c, int delta) {
+     uint64_t pattern = cube_pattern(t, c);
+     CUBE_WORDS(t, c, w) {
+         for (uint64_t m = pattern; m; m &= m - 1) {
+             t->counts[w * 64 + (uint64_t)__builtin_ctzll(m)] += (uint32_t)delta;
+         }
+     }
+ }
+
+ /* -------------------------------------------------------------------------
+  * cube_is_shared:
+  *   Tells whether every row of cube 'c' is also covered by another cube.
+  * ------------------------------------------------------------------------- */
+ static int cube_is_shared(const Table *t, Cube c) {
+     uint64_t pattern = cube_pattern(t, c);
+     CUBE_WORDS(t, c, w) {
+         for (uint64_t m = pattern; m; m &= m - 1) {
+             if (t->counts[w * 64 + (uint64_t)__builtin_ctzll(m)] < 2) {
+                 return 0;
+             }
+         }
+     }
+     return 1;
+ }
+
+ /* -------------------------------------------------------------------------
+  * expand_cube:
+  *   Grows a cube inside the function into a prime implicant by dropping
+  *   literals in the given order wherever the other half of the enlarged
+  *   cube is inside the function as well. A literal that cannot be dropped
+  *   at some point cannot be dropped from any larger cube either, so one
+  *   pass is enough.
+  * ------------------------------------------------------------------------- */
+ static Cube expand_cube(const Table *t, Cube c, const int *order) {
+     for (int k = 0; k < t->var_count; k++) {
+         uint64_t bit = 1ULL << order[k];
+         if (c.mask & bit) {
+             Cube other = { c.mask, c.bits ^ bit };
+             if (cube_implies(t, other)) {
+                 c.mask &= ~bit;
+                 c.bits &= ~bit;
+             }
+         }
+     }
+     return c;
+ }
+
+ /* -------------------------------------------------------------------------
+  * expansion_order:
+  *   Orders the literals of cube 'c' for expand_cube. Dropping a literal
+  *   brings c closer to every other cube that is free in that variable
+  *   while agreeing on the rest, or that conflicts with c in that variable
+  *   alone; literals that help with the most cubes go first, so expanded
+  *   cubes tend to swallow the rest of the cover.
+  * ------------------------------------------------------------------------- */
+ static void expansion_order(const Table *t, const Cover *cover, Cube c, int *order) {
+     int weight[MAX_VARS] = { 0 };
+     for (int i = 0; i < cover->count; i++) {
+         Cube d = cover->cubes[i];
+         uint64_t conflict = (c.bits ^ d.bits) & c.mask & d.mask;
+         if (conflict == 0) {
+             for (uint64_t m = c.mask & ~d.mask; m; m &= m - 1) {
+                 weight[__builtin_ctzll(m)]++;
+             }
+         } else if ((conflict & (conflict - 1)) == 0) {
+             weight[__builtin_ctzll(conflict)]++;
+         }
+     }
+     for (int v = 0; v < t->var_count; v++) {
+         int k = v;
+         while (k > 0 && weight[order[k - 1]] < weight[v]) {
+             order[k] = order[k - 1];
+             k--;
+         }
+         order[k] = v;
+     }
+ }
+
+ /* -------------------------------------------------------------------------
+  * irredundant:
+  *   Drops every cube whose rows are all covered by other cubes, trying the
+  *   smallest cubes first. Leaves t->counts matching the remaining cover.
+  * ------------------------------------------------------------------------- */
+ static int compare_size(const void *a, const void *b) {
+     int x = cube_literals(*(const Cube *)a), y = cube_literals(*(const Cube *)b);
+     return y - x;
+ }
+
+ static void irredundant(Table *t, Cover *cover) {
+     memset(t->counts, 0, (t->words * 64) * sizeof(uint32_t));
+     for (int i = 0; i < cover->count; i++) {
+         cube_count_rows(t, cover->cubes[i], 1);
+     }
+     qsort(cover->cubes, (size_t)cover->count, sizeof(Cube), compare_size);
+     int kept = 0;
+     for (int i = 0; i < cover->count; i++) {
+         Cube c = cover->cubes[i];
+         if (cube_is_shared(t, c)) {
+             cube_count_rows(t, c, -1);
+         } else {
+             cover->cubes[kept++] = c;
+         }
+     }
+     cover->count = kept;
+ }
+
+ /* -------------------------------------------------------------------------
+  * reduce:
+  *   Shrinks every cube, largest first, to the smallest cube holding the
+  *   rows that no other cube covers, so the next expansion can grow it in
+  *   a different direction. Keeps t->counts up to date.
+  * ------------------------------------------------------------------------- */
+ static void reduce(Table *t, Cover *cover) {
+     for (int i = cover->count - 1; i >= 0; i--) {
+         Cube c = cover->cubes[i];
+         uint64_t all_and = t->all, all_or = 0;
+         uint64_t pattern = cube_pattern(t, c);
+         CUBE_WORDS(t, c, w) {
+             for (uint64_t m = pattern; m; m &= m - 1) {
+                 uint64_t row = w * 64 + (uint64_t)__builtin_ctzll(m);
+                 if (t->counts[row] == 1) {
+                     all_and &= row;
+                     all_or |= row;
+                 }
+             }
+         }
+         if (all_or == 0 && all_and == t->all) {
+             continue;
+         }
+         // The bits on which all unique rows agree become literals
+         uint64_t agree = t->all & ~(all_and ^ all_or);
+         Cube reduced = { agree, all_and & agree };
+         cube_count_rows(t, c, -1);
+         cube_count_rows(t, reduced, 1);
+         cover->cubes[i] = reduced;
+     }
+ }
+
+ /* -------------------------------------------------------------------------
+  * espresso:
+  *   Minimizes a table heuristically. Every uncovered row of the function is
+  *   expanded into a prime implicant, redundant primes are dropped, and then
+  *   rounds of reduce, expand and irredundant look for a cheaper cover for
+  *   as long as they keep finding one.
+  *
+  *   Returns:
+  *     0 on success, -1 if memory ran out.
+  * ------------------------------------------------------------------------- */
+ static int espresso(Table *t, Cover *cover) {
+     int order[MAX_VARS];
+     for (int v = 0; v < t->var_count; v++) {
+         order[v] = t->var_count - v - 1;
+     }
+
+     // Expand each row no earlier prime covers; counts marks covered rows
+     memset(t->counts, 0, (t->words * 64) * sizeof(uint32_t));
+     for (size_t w = 0; w < t->words; w++) {
+         for (uint64_t m = t->on[w]; m; m &= m - 1) {
+             uint64_t row = w * 64 + (uint64_t)__builtin_ctzll(m);
+             if (t->counts[row]) {
+                 continue;
+             }
+             Cube prime = expand_cube(t, (Cube){ t->all, row }, order);
+             if (cover_push(cover, prime) != 0) {
+                 return -1;
+             }
+             cube_count_rows(t, prime, 1);
+         }
+     }
+     if (cover->count == 0) {
+         return 0;
+     }
+     irredundant(t, cover);
+
+     Cube *best = malloc((size_t)(cover->count + 1) * sizeof(Cube));
+     if (!best) {
+         return -1;
+     }
+     int best_count = cover->count;
+     memcpy(best, cover->cubes, (size_t)cover->count * sizeof(Cube));
+     uint64_t best_cost = cover_cost(best, best_count);
+
+     for (int round = 0; round < ESPRESSO_ROUNDS; round++) {
+         reduce(t, cover);
+         for (int i = 0; i < cover->count; i++) {
+             expansion_order(t, cover, cover->cubes[i], order);
+             cover->cubes[i] = expand_cube(t, cover->cubes[i], order);
+         }
+         irredundant(t, cover);
+         uint64_t cost = cover_cost(cover->cubes, cover->count);
+         if (cost >= best_cost) {
+             break;
+         }
+         best_cost = cost;
+         best_count = cover->count;
+         memcpy(best, cover->cubes, (size_t)cover->count * sizeof(Cube));
+     }
+     memcpy(cover->cubes, best, (size_t)best_count * sizeof(Cube));
+     cover->count = best_count;
+     free(best);
+     return 0;
+ }
+
+ /* -------------------------------------------------------------------------
+  * Exact Covering:
+  * After Quine-McCluskey has found every prime implicant, the covering table
+  * has, for each prime, a bitset of the minterms it covers, and for each
+  * minterm the bitset of the primes covering it. A branch-and-bound search
+  * repeatedly takes the uncovered minterm with the fewest primes and tries
+  * each of them, so essential primes are chosen without branching. The
+  * search gives up after QM_MAX_BRANCHES branches, keeping its best cover.
+  * ------------------------------------------------------------------------- */
+ typedef struct {
+     int prime_count;
+     const Cube *primes;
+     int minterm_count;
+     size_t minterm_words;     /* words of a minterm bitset */
+     size_t prime_words;       /* words of a prime bitset */
+     uint64_t *covers;         /* prime p: minterm bitset at p * minterm_words */
+     uint64_t *covered_by;     /* minterm i: prime bitset at i * prime_words */
+     int *choices;             /* number of primes covering each minterm */
+     int *chosen;
+     int *best;
+     int best_count;
+     uint64_t best_cost;
+     long branches;
+ } CoverSearch;
+
+ static void search_cover(CoverSearch *s, uint64_t *uncovered, int depth, uint64_t cost) {
+     if (s->branches++ > QM_MAX_BRANCHES) {
+         return;
+     }
+     // Pick the uncovered minterm that the fewest primes cover
+     int pick = -1, fewest = 0;
+     for (size_t w = 0; w < s->minterm_words; w++) {
+         for (uint64_t m = uncovered[w]; m; m &= m - 1) {
+             int i = (int)(w * 64) + __builtin_ctzll(m);
+             if (pick < 0 || s->choices[i] < fewest) {
+                 pick = i;
+                 fewest = s->choices[i];
+             }
+         }
+     }
+     if (pick < 0) {
+         if (cost < s->best_cost) {
+             s->best_cost = cost;
+             s->best_count = depth;
+             memcpy(s->best, s->chosen, (size_t)depth * sizeof(int));
+         }
+         return;
+     }
+     // Every further prime adds a product, so this branch cannot win
+     if (cost + (1ULL << 32) >= s->best_cost) {
+         return;
+     }
+
+     uint64_t *next = uncovered + s->minterm_words;
+     const uint64_t *by = s->covered_by + (size_t)pick * s->prime_words;
+     for (size_t k = 0; k < s->prime_words; k++) {
+         for (uint64_t m = by[k]; m; m &= m - 1) {
+             int p = (int)(k * 64) + __builtin_ctzll(m);
+             const uint64_t *covers = s->covers + (size_t)p * s->minterm_words;
+             for (size_t w = 0; w < s->minterm_words; w++) {
+                 next[w] = uncovered[w] & ~covers[w];
+             }
+             s->chosen[depth] = p;
+             search_cover(s, next, depth + 1,
+                          cost + (1ULL << 32) + (uint64_t)cube_literals(s->primes[p]));
+         }
+     }
+ }
+
+ /* -------------------------------------------------------------------------
+  * quine_mccluskey:
+  *   Minimizes a table exactly. Instead of merging lists of cubes pairwise,
+  *   every cube is numbered in base 3, digit v being 0 or 1 for a literal
+  *   of variable bit v and 2 where v is free, and one bit per number records
+  *   whether that cube lies inside the function: a cube with a free digit
+  *   is inside exactly when its two halves (the same number with that digit
+  *   0 and 1, both smaller) are. A cube inside the function is prime when
+  *   freeing any of its literals leaves the function, and search_cover
+  *   then picks the cheapest set of primes, replacing the heuristic cover
+  *   passed in if it finds a cheaper one.
+  *
+  *   Returns:
+  *     0 on success, 1 if there are too many primes for an exact cover,
+  *     -1 if memory ran out.
+  * ------------------------------------------------------------------------- */
+ static int quine_mccluskey(const Table *t, Cover *cover) {
+     int n = t->var_count;
+     Cover primes = { 0 };
+     int rc = -1;
+     uint64_t *inside = NULL, *minterms = NULL, *bits = NULL;
+     int *picks = NULL;
+
+     size_t pow3[MAX_VARS + 1];
+     pow3[0] = 1;
+     for (int v = 0; v < n; v++) {
+         pow3[v + 1] = pow3[v] * 3;
+     }
+     inside = calloc(pow3[n] / 64 + 1, sizeof(uint64_t));
+     if (!inside) {
+         goto done;
+     }
+ #define INSIDE(c) (inside[(c) / 64] >> ((c) % 64) & 1)
+
+     unsigned char digit[MAX_VARS] = { 0 };
+     for (size_t c = 0; c < pow3[n]; c++) {
+         int v = 0;
+         while (v < n && digit[v] != 2) {
+             v++;
+         }
+         uint64_t in;
+         if (v < n) {
+             in = INSIDE(c - 2 * pow3[v]) & INSIDE(c - pow3[v]);
+         } else {
+             uint64_t row = 0;
+             for (int k = 0; k < n; k++) {
+                 row |= (uint64_t)digit[k] << k;
+             }
+             in = t->on[row / 64] >> (row % 64) & 1;
+         }
+         inside[c / 64] |= in << (c % 64);
+         // Count on in base 3
+         for (int k = 0; k < n && ++digit[k] == 3; k++) {
+             digit[k] = 0;
+         }
+     }
+
+     for (size_t c = 0; c < pow3[n]; c++) {
+         if (INSIDE(c)) {
+             Cube cube = { 0, 0 };
+             int prime = 1;
+             for (int k = 0; k < n && prime; k++) {
+                 if (digit[k] != 2) {
+                     prime = !INSIDE(c + (size_t)(2 - digit[k]) * pow3[k]);
+                     cube.mask |= 1ULL << k;
+                     cube.bits |= (uint64_t)digit[k] << k;
+                 }
+             }
+             if (prime && cover_push(&primes, cube) != 0) {
+                 goto done;
+             }
+             if (primes.count > QM_MAX_PRIMES) {
+                 rc = 1;
+                 goto done;
+             }
+         }
+         for (int k = 0; k < n && ++digit[k] == 3; k++) {
+             digit[k] = 0;
+         }
+     }
+ #undef INSIDE
+
+     int minterm_count = 0;
+     for (size_t w = 0; w < t->words; w++) {
+         minterm_count += __builtin_popcountll(t->on[w]);
+     }
+     minterms = malloc((size_t)(minterm_count + 1) * sizeof(uint64_t));
+     if (!minterms) {
+         goto done;
+     }
+     minterm_count = 0;
+     for (size_t w = 0; w < t->words; w++) {
+         for (uint64_t m = t->on[w]; m; m &= m - 1) {
+             minterms[minterm_count++] = w * 64 + (uint64_t)__builtin_ctzll(m);
+         }
+     }
+
+     // Build the covering table in both directions
+     CoverSearch s = { 0 };
+     s.prime_count = primes.count;
+     s.primes = primes.cubes;
+     s.minterm_count = minterm_count;
+     s.minterm_words = (size_t)(minterm_count + 63) / 64;
+     s.prime_words = (size_t)(primes.count + 63) / 64;
+     size_t table_words = (size_t)primes.count * s.minterm_words
+                        + (size_t)minterm_count * s.prime_words
+                        + (size_t)(primes.count + 1) * s.minterm_words;
+     bits = calloc(table_words + 1, sizeof(uint64_t));
+     picks = malloc((size_t)(2 * primes.count + minterm_count + 2) * sizeof(int));
+     if (!bits || !picks) {
+         goto done;
+     }
+     s.covers = bits;
+     s.covered_by = s.covers + (size_t)primes.count * s.minterm_words;
+     uint64_t *uncovered = s.covered_by + (size_t)minterm_count * s.prime_words;
+     s.chosen = picks;
+     s.best = picks + primes.count + 1;
+     s.choices = s.best + primes.count + 1;
+     memset(s.choices, 0, (size_t)minterm_count * sizeof(int));
+     for (int p = 0; p < primes.count; p++) {
+         Cube c = primes.cubes[p];
+         for (int i = 0; i < minterm_count; i++) {
+             if ((minterms[i] & c.mask) == c.bits) {
+                 s.covers[(size_t)p * s.minterm_words + (size_t)i / 64] |= 1ULL << (i % 64);
+                 s.covered_by[(size_t)i * s.prime_words + (size_t)p / 64] |= 1ULL << (p % 64);
+                 s.choices[i]++;
+             }
+         }
+     }
+     for (int i = 0; i < minterm_count; i++) {
+         uncovered[i / 64] |= 1ULL << (i % 64);
+     }
+
+     // Only a cover cheaper than the heuristic one is of interest
+     uint64_t heuristic = cover_cost(cover->cubes, cover->count);
+     s.best_cost = heuristic;
+     search_cover(&s, uncovered, 0, 0);
+     if (s.best_cost < heuristic) {
+         cover->count = 0;
+         for (int k = 0; k < s.best_count; k++) {
+             if (cover_push(cover, primes.cubes[s.best[k]]) != 0) {
+                 goto done;
+             }
+         }
+     }
+     rc = 0;
+
+ done:
+     free(primes.cubes);
+     free(inside);
+     free(minterms);
+     free(bits);
+     free(picks);
+     return rc;
+ }
+
+ /* -------------------------------------------------------------------------
+  * store_rows:
+  *   ChunkCallback that copies a chunk of results into the table bitmap.
+  *   Chunks start on a multiple of CHUNK_ROWS, hence of 64.
+  * ------------------------------------------------------------------------- */
+ static void store_rows(void *ctx, uint64_t first_row, uint64_t count,
+                        const uint64_t *results) {
+     Table *t = ctx;
+     memcpy(t->on + first_row / 64, results, (size_t)((count + 63) / 64) * sizeof(uint64_t));
+ }
+
+ /* -------------------------------------------------------------------------
+  * compare_products:
+  *   Orders cubes for printing, variable by variable in slot order: a
+  *   positive literal first, then a negative one, then none.
+  * ------------------------------------------------------------------------- */
+ static int compare_products(const void *a, const void *b) {
+     const Cube *x = a, *y = b;
+     uint64_t differ = (x->mask ^ y->mask) | ((x->bits ^ y->bits) & x->mask & y->mask);
+     if (differ == 0) {
+         return 0;
+     }
+     uint64_t bit = 1ULL << (63 - __builtin_clzll(differ));
+     int rank_x = !(x->mask & bit) ? 2 : !(x->bits & bit);
+     int rank_y = !(y->mask & bit) ? 2 : !(y->bits & bit);
+     return rank_x - rank_y;
+ }
+
+ /* -------------------------------------------------------------------------
+  * minimize_table:
+  *   Minimizes the function of a table heuristically and then, when it is
+  *   small enough, exactly.
+  * ------------------------------------------------------------------------- */
+ static int minimize_table(Table *t, Cover *cover) {
+     if (espresso(t, cover) != 0) {
+         return -1;
+     }
+     // An exact search bounded by the heuristic cover prunes early
+     if (t->var_count <= QM_MAX_VARS && quine_mccluskey(t, cover) < 0) {
+         return -1;
+     }
+     if (cover->count > 1) {
+         qsort(cover->cubes, (size_t)cover->count, sizeof(Cube), compare_products);
+     }
+     return 0;
+ }
+
+ /* -------------------------------------------------------------------------
+  * minimize_program:
+  *   Computes a minimal sum of products for a compiled expression and,
+  *   optionally, one for its negation, from which a minimal product of sums
+  *   follows by De Morgan's laws.
+  *
+  *   Parameters:
+  *     prog    - The compiled expression, with at most MINIMIZE_MAX_VARS
+  *               variables.
+  *     threads - Number of threads evaluating its truth table.
+  *     sop     - Receives the cover of the expression.
+  *     pos     - Receives the cover of its negation, or NULL if not wanted.
+  *
+  *   Returns:
+  *     0 on success, -1 if there are too many variables or memory ran out.
+  * ------------------------------------------------------------------------- */
+ int minimize_program(const Program *prog, int threads, Cover *sop, Cover *pos) {
+     memset(sop, 0, sizeof(*sop));
+     if (pos) {
+         memset(pos, 0, sizeof(*pos));
+     }
+     if (prog->var_count > MINIMIZE_MAX_VARS) {
+         return -1;
+     }
+     Table t;
+     t.var_count = prog->var_count;
+     t.all = (1ULL << t.var_count) - 1;
+     t.words = t.var_count > 6 ? (size_t)1 << (t.var_count - 6) : 1;
+     t.valid = t.var_count >= 6 ? ~0ULL : (1ULL << (1 << t.var_count)) - 1;
+     t.on = calloc(t.words, sizeof(uint64_t));
+     t.counts = malloc(t.words * 64 * sizeof(uint32_t));
+     int rc = -1;
+     if (t.on && t.counts
+         && parallel_truth_table(prog, threads, store_rows, &t) == 0) {
+         t.on[t.words - 1] &= t.valid;
+         sop->var_count = prog->var_count;
+         memcpy(sop->vars, prog->vars, (size_t)prog->var_count);
+         rc = minimize_table(&t, sop);
+         if (rc == 0 && pos) {
+             pos->var_count = prog->var_count;
+             memcpy(pos->vars, prog->vars, (size_t)prog->var_count);
+             for (size_t w = 0; w < t.words; w++) {
+                 t.on[w] = ~t.on[w] & t.valid;
+             }
+             rc = minimize_table(&t, pos);
+         }
+     }
+     free(t.on);
+     free(t.counts);
+     if (rc != 0) {
+         free_cover(sop);
+         if (pos) {
+             free_cover(pos);
+         }
+     }
+     return rc;
+ }
+
+ /* -------------------------------------------------------------------------
+  * write_cover:
+  *   Writes a cover as an expression: a sum of products such as
+  *   "A·!B + C", or, for the cover of a negation, the product of sums
+  *   it stands for, such as "(!A + B)·!C".
+  *
+  *   Parameters:
+  *     cover           - The cover, as filled in by minimize_program.
+  *     product_of_sums - Non-zero if it covers the negation.
+  *     out             - The stream the expression is written to.
+  * ------------------------------------------------------------------------- */
+ void write_cover(const Cover *cover, int product_of_sums, FILE *out) {
+     const char *join = product_of_sums ? "·" : " + ";
+     const char *inner = product_of_sums ? " + " : "·";
+     if (cover->count == 0) {
+         fputs(product_of_sums ? "1" : "0", out);
+         return;
+     }
+     for (int i = 0; i < cover->count; i++) {
+         Cube c = cover->cubes[i];
+         int literals = cube_literals(c);
+         if (i > 0) {
+             fputs(join, out);
+         }
+         if (literals == 0) {
+             fputs(product_of_sums ? "0" : "1", out);
+             continue;
+         }
+         int group = product_of_sums && literals > 1 && cover->count > 1;
+         if (group) {
+             fputc('(', out);
+         }
+         int first = 1;
+         for (int j = 0; j < cover->var_count; j++) {
+             uint64_t bit = 1ULL << (cover->var_count - j - 1);
+             if (!(c.mask & bit)) {
+                 continue;
+             }
+             // A clause of the product holds the negated literals of the cube
+             int negated = product_of_sums ? (c.bits & bit) != 0 : !(c.bits & bit);
+             fprintf(out, "%s%s%c", first ? "" : inner, negated ? "!" : "", cover->vars[j]);
+             first = 0;
+         }
+         if (group) {
+             fputc(')', out);
+         }
+     }
+ }
+
+ /* -------------------------------------------------------------------------
+  * free_cover:
+  *   Frees the cubes of a cover.
+  * ------------------------------------------------------------------------- */
+ void free_cover(Cover *cover) {
+     free(cover->cubes);
+     cover->cubes = NULL;
+     cover->count = cover->capacity = 0;
+ }
\ No newline at end of file
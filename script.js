@@ -24,12 +24,45 @@ function convertComplement() {
   input.value = input.value.replace(/([A-Za-z])̅/g, "!$1");
 }
 
+// The solver core built for the browser by "make wasm", once it has loaded
+var wasmSolver = null;
+
+/**
+ * Loads boolsolve.js and boolsolve.wasm if the page includes them. Until
+ * they have loaded, or if they are missing, every request goes to the
+ * backend.
+ */
+function loadWasmSolver() {
+  if (typeof createBoolSolve !== "function") return;
+  createBoolSolve()
+    .then(module => {
+      let exports = ["_bs_evaluate", "_bs_truth_table_page", "_bs_last_error"];
+      let missing = exports.filter(name => typeof module[name] !== "function");
+      if (typeof module.cwrap !== "function" || missing.length > 0) {
+        throw new Error("Missing exports: " + (missing.join(", ") || "cwrap"));
+      }
+      wasmSolver = {
+        evaluate: module.cwrap("bs_evaluate", "number", ["string", "string"]),
+        truthTablePage: module.cwrap("bs_truth_table_page", "string", ["string", "number", "number"]),
+        lastError: module.cwrap("bs_last_error", "string", [])
+      };
+    })
+    .catch(error => {
+      console.warn("WebAssembly solver unavailable, using the backend:", error);
+    });
+}
+
 /**
- * Calls the backend to evaluate the expression or falls back to local JS evaluation.
+ * Evaluates the expression in the browser when the WebAssembly solver has
+ * loaded, else calls the backend.
  * @param {string} expression - The user’s Boolean expression.
  */
 function evaluateExpression(expression) {
   var outputDiv = document.getElementById("result-output");
+  if (wasmSolver) {
+    showLocalEvaluation(expression);
+    return;
+  }
   outputDiv.innerHTML = "<p>Evaluating...</p>";
 
   // Attempt call to CGI script
@@ -42,103 +75,187 @@ function evaluateExpression(expression) {
       outputDiv.innerHTML = "<pre>" + data + "</pre>";
     })
     .catch(error => {
-      console.warn("CGI call failed, using local evaluation:", error);
-      var result = localEvaluate(expression);
-      outputDiv.innerHTML = "<p>Local Evaluation Result:</p><pre>" + result + "</pre>";
+      console.warn("CGI call failed:", error);
+      if (wasmSolver) {
+        showLocalEvaluation(expression);
+      } else {
+        outputDiv.innerHTML = "<p>Error: The solver could not be reached.</p>";
+      }
     });
 }
 
 /**
- * Simplistic local evaluation: replaces variables with "true," converts + to ||, etc.
+ * Shows the result of the expression with every variable true, computed by
+ * the WebAssembly solver exactly as the backend computes it.
  * @param {string} expression - Boolean expression to evaluate.
  */
-function localEvaluate(expression) {
-  // Handle complement forms
-  let expr = expression.replace(/([A-Za-z])'/g, "!$1").replace(/([A-Za-z])̅/g, "!$1");
-  expr = expr.replace(/·/g, "&&").replace(/\+/g, "||");
-
-  // Replace variables (A, B, C...) with true for demonstration
-  if (/[A-Za-z]/.test(expr)) {
-    let variables = Array.from(new Set(expr.match(/[A-Za-z]/g)));
-    variables.forEach(v => {
-      let re = new RegExp("\\b" + v + "\\b", "g");
-      expr = expr.replace(re, "true");
-    });
-  }
-
-  try {
-    let result = eval(expr);
-    return result;
-  } catch (e) {
-    return "Error evaluating: " + e.message;
-  }
+function showLocalEvaluation(expression) {
+  var result = wasmSolver.evaluate(expression, null);
+  document.getElementById("result-output").innerHTML = result < 0
+    ? "<p>Error: " + wasmSolver.lastError() + "</p>"
+    : "<p>Evaluation Result:</p><pre>Result: " + result + "</pre>";
 }
 
+// Rows requested from the backend per truth-table page
+var TRUTH_TABLE_PAGE_ROWS = 256;
+// Watches the end of the current server-side table for the next page
+var truthTableObserver = null;
+
 /**
- * Generates a truth table by enumerating all variable combinations.
+ * Shows a truth table from the backend one page at a time: the first page
+ * right away, and every further page once the user scrolls near the end of
+ * the table, so no more of a large table is computed or rendered than is
+ * seen. Pages come from the WebAssembly solver when it has loaded, else
+ * from the backend.
  * @param {string} expression - Boolean expression for which to build the table.
  */
-function generateTruthTable(expression) {
-  let varMatches = expression.match(/[A-Za-z]/g);
-  if (!varMatches) {
-    document.getElementById("result-output").innerHTML =
-      "<p>No variables found in the expression.</p>";
-    return;
+function loadTruthTable(expression) {
+  var outputDiv = document.getElementById("result-output");
+  outputDiv.innerHTML = "<p>Generating...</p>";
+  if (truthTableObserver) {
+    truthTableObserver.disconnect();
+    truthTableObserver = null;
   }
 
-  let variables = Array.from(new Set(varMatches)).sort();
-  let numVars = variables.length;
-  let numRows = 1 << numVars; // 2^numVars
-
-  // Start building HTML
-  let tableHTML = "<table><thead><tr>";
-  variables.forEach(v => {
-    tableHTML += "<th>" + v + "</th>";
+  var state = { expression: expression, next: 0, total: 0, body: null, sentinel: null, observer: null };
+  fetchTruthTablePage(state).catch(error => {
+    console.warn("Truth table failed:", error);
+    // The WebAssembly solver may have loaded while the backend failed
+    if (wasmSolver && state.body === null) {
+      fetchTruthTablePage(state).catch(retryError => {
+        outputDiv.innerHTML = "<p>Error: " + retryError.message + "</p>";
+      });
+    } else {
+      outputDiv.innerHTML = "<p>Error: The solver could not be reached.</p>";
+    }
   });
-  tableHTML += "<th>Result</th></tr></thead><tbody>";
+}
 
-  for (let i = 0; i < numRows; i++) {
-    // Build a truth assignment for each var
-    let rowMapping = {};
-    for (let j = 0; j < numVars; j++) {
-      rowMapping[variables[j]] = Boolean((i >> (numVars - j - 1)) & 1);
+/**
+ * Fetches the next page of a truth table and appends its rows as they
+ * arrive. The WebAssembly solver builds the page in the same layout as
+ * the backend.
+ * @param {object} state - The table being shown, as set up by loadTruthTable.
+ * @returns {Promise} Settles once the page has been added.
+ */
+function fetchTruthTablePage(state) {
+  var pageEnd = null;
+  function addRows(text) {
+    // The page's bounds come before its first row
+    if (pageEnd === null) {
+      let page = text.match(/data-offset='(\d+)' data-rows='(\d+)' data-total-rows='(\d+)'/);
+      if (!page) return;
+      pageEnd = Number(page[1]) + Number(page[2]);
+      state.total = Number(page[3]);
     }
+    appendTruthTableRows(state, text);
+  }
 
-    // Convert complement notations, then replace custom operators with JS ones
-    let evalExpr = expression
-      .replace(/([A-Za-z])'/g, "!$1")
-      .replace(/([A-Za-z])̅/g, "!$1")
-      .replace(/·/g, "&&")
-      .replace(/\+/g, "||");
-
-    // Substitute each variable with "true" or "false"
-    variables.forEach(v => {
-      let re = new RegExp("\\b" + v + "\\b", "g");
-      evalExpr = evalExpr.replace(re, rowMapping[v] ? "true" : "false");
+  var rows;
+  if (wasmSolver) {
+    rows = Promise.resolve().then(() => {
+      let text = wasmSolver.truthTablePage(state.expression, state.next, TRUTH_TABLE_PAGE_ROWS);
+      if (text === null) throw new Error(wasmSolver.lastError());
+      addRows(text);
     });
-
-    // Evaluate final expression
-    let result;
-    try {
-      result = eval(evalExpr) ? 1 : 0;
-    } catch (e) {
-      result = "Err";
+  } else {
+    let url = "/cgi-bin/server.cgi?mode=tt&expr=" + encodeURIComponent(state.expression) +
+      "&offset=" + state.next + "&limit=" + TRUTH_TABLE_PAGE_ROWS;
+    rows = fetch(url).then(response => {
+      if (!response.ok) throw new Error("Network response was not ok.");
+      return readTableRows(response, addRows);
+    });
+  }
+  return rows.then(() => {
+    if (pageEnd === null || state.body === null) throw new Error("No truth table in the response.");
+    state.next = pageEnd;
+    if (state.next < state.total) {
+      state.sentinel.textContent = "Showing " + state.next + " of " + state.total + " rows...";
+      state.observer.observe(state.sentinel);
+    } else {
+      state.sentinel.textContent = "";
     }
+  });
+}
 
-    // Generate table row
-    tableHTML += "<tr>";
-    variables.forEach(v => {
-      tableHTML += "<td>" + (rowMapping[v] ? "1" : "0") + "</td>";
+/**
+ * Reads a response as it arrives and passes it on cut after the last
+ * complete row received so far. A large table is sent while the backend is
+ * still computing it, so its first rows can be shown long before the last.
+ * @param {Response} response - The backend's response.
+ * @param {function(string)} onRows - Called with each piece of the page, in order.
+ * @returns {Promise} Settles once the whole response has been passed on.
+ */
+function readTableRows(response, onRows) {
+  if (!response.body) return response.text().then(onRows);
+  let reader = response.body.getReader();
+  let decoder = new TextDecoder();
+  let pending = "";
+  function readMore() {
+    return reader.read().then(({ done, value }) => {
+      if (done) {
+        onRows(pending + decoder.decode());
+        return;
+      }
+      pending += decoder.decode(value, { stream: true });
+      let cut = pending.lastIndexOf("</tr>") + 5;
+      if (cut > 4) {
+        onRows(pending.substring(0, cut));
+        pending = pending.substring(cut);
+      }
+      return readMore();
     });
-    tableHTML += "<td>" + result + "</td></tr>";
   }
+  return readMore();
+}
 
-  tableHTML += "</tbody></table>";
-  document.getElementById("result-output").innerHTML = tableHTML;
+/**
+ * Appends the rows in a piece of a truth-table page. Every page starts with
+ * the header row; the first one seen sets up the table and the rest are
+ * dropped.
+ * @param {object} state - The table being shown, as set up by loadTruthTable.
+ * @param {string} text - HTML holding zero or more complete rows.
+ */
+function appendTruthTableRows(state, text) {
+  let start = text.indexOf("<tr");
+  if (start < 0) return;
+  let template = document.createElement("template");
+  template.innerHTML = "<table>" + text.substring(start) + "</table>";
+  let rows = Array.from(template.content.querySelectorAll("tr"));
+  let header = rows.find(row => row.querySelector("th"));
+  rows = rows.filter(row => !row.querySelector("th"));
+
+  if (state.body === null) {
+    if (!header) return;
+    let outputDiv = document.getElementById("result-output");
+    let table = document.createElement("table");
+    let head = document.createElement("thead");
+    head.appendChild(header);
+    table.appendChild(head);
+    state.body = document.createElement("tbody");
+    table.appendChild(state.body);
+    state.sentinel = document.createElement("p");
+    outputDiv.innerHTML = "";
+    outputDiv.appendChild(table);
+    outputDiv.appendChild(state.sentinel);
+    state.observer = truthTableObserver = new IntersectionObserver(entries => {
+      if (entries[0].isIntersecting && state.next < state.total) {
+        state.observer.unobserve(state.sentinel);
+        fetchTruthTablePage(state).catch(error => {
+          state.sentinel.textContent = "Error loading rows: " + error.message;
+        });
+      }
+    }, { rootMargin: "200px" });
+  }
+  let rowsHere = document.createDocumentFragment();
+  rows.forEach(row => rowsHere.appendChild(row));
+  state.body.appendChild(rowsHere);
 }
 
 // Attach button listeners once DOM is ready
 document.addEventListener("DOMContentLoaded", function () {
+  loadWasmSolver();
+
   document.getElementById("btn-evaluate").addEventListener("click", function () {
     var expression = document.getElementById("bool-expression").value;
     evaluateExpression(expression);
@@ -146,6 +263,6 @@ document.addEventListener("DOMContentLoaded", function () {
 
   document.getElementById("btn-truth-table").addEventListener("click", function () {
     var expression = document.getElementById("bool-expression").value;
-    generateTruthTable(expression);
+    loadTruthTable(expression);
   });
 });
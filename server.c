@@ -4,337 +4,1912 @@
  * This program extracts the Boolean expression from the query string,
  * decodes it, and then processes it. If the "mode" parameter is set to "tt",
  * it generates a truth table; otherwise, it simply evaluates the expression.
+ * An optional "assign" parameter (e.g. "A=0,B=1") sets variable values for
+ * the evaluation. In "tt" mode, "filter=true" or "filter=false" keeps only
+ * the rows with that result, and "offset" and "limit" select a page of rows
+ * so that only that page is evaluated. The modes "sat" and "count" instead
+ * answer, with a BDD and without a truth table, whether the expression is
+ * satisfiable and how many assignments satisfy it. The modes "equiv" and
+ * "tautology" answer whether it is equivalent to the expression in the
+ * "expr2" parameter, or always true, with an assignment on which that
+ * fails; the truth table is swept only up to the first such assignment,
+ * and expressions too wide for that are compared with a BDD. The mode
+ * "simplify" derives a minimal sum of products and product of sums from the
+ * truth table.
+ *
+ * Programmatic clients can ask for "format=json" instead of an HTML page:
+ * one JSON object with the expression and the result, where a truth table
+ * is a base64 bitmap of its results (bit k of the bitmap, LSB first, is row
+ * offset + k). "format=bin" sends a truth table as that bitmap, raw, after
+ * the header of the solver's "--format bin"; in other modes it means JSON.
+ * Errors are reported in an "error" member, except that a bitmap that runs
+ * out of memory is answered with status 500 and an empty body.
  *
  * The expression is expected to use the following operators:
  *   - '+' for logical OR
- *   - '·' for logical AND
+ *   - '·' for logical AND (or its ASCII aliases '&' and '*')
  *   - '!' for logical NOT
  * Parentheses '(' and ')' are supported for grouping.
  *
- * For demonstration purposes, when evaluating an expression,
- * any alphabetic variable (e.g. A, B, C) is assumed to have the value 1.
+ * When evaluating an expression, any alphabetic variable (e.g. A, B, C)
+ * that "assign" does not mention is assumed to have the value 1.
  *
  * Compile with:
- *   gcc -o server.cgi server.c
+ *   make server.cgi     (links against libboolsolve.a, see boolsolve.h)
+ *
+ * Usage:
+ *   As a CGI program, the web server runs it once per request with the
+ *   query in QUERY_STRING.
+ *
+ *   ./server.cgi --listen [HOST:]PORT [--threads N] [--cache-mb N]
+ *     - Runs as a persistent HTTP server that answers every request from one
+ *       long-running process (HOST defaults to 127.0.0.1). Results of recent
+ *       requests are kept in an LRU cache of at most N MB (default 64, 0
+ *       disables it); GET /stats reports its hit and miss counters.
+ *       Built with "make METRICS=1", it also serves per-stage timers,
+ *       counters and a latency histogram on GET /metrics for Prometheus.
+ *       Truth tables of 65536 rows or more are sent to HTTP/1.1 clients
+ *       with chunked transfer encoding while they are computed.
+ *
+ *   Truth tables are evaluated on N threads (default 1), set with --threads
+ *   or, for CGI, the SOLVER_THREADS environment variable.
  */
 
+ #define _GNU_SOURCE
+ #include "boolsolve.h"
+
  #include <stdio.h>
  #include <stdlib.h>
  #include <string.h>
  #include <ctype.h>
+ #include <stdint.h>
+ #include <errno.h>
+ #include <fcntl.h>
+ #include <limits.h>
+ #include <signal.h>
+ #include <strings.h>
+ #include <unistd.h>
+ #include <arpa/inet.h>
+ #include <netinet/in.h>
+ #include <sys/epoll.h>
+ #include <sys/socket.h>
+ #ifdef SERVER_METRICS
+ #include <time.h>
+ #endif
+ 
+ /* ============================ */
+ /* Metrics                      */
+ /* ============================ */
+ 
+ /*
+  * Built with SERVER_METRICS defined ("make METRICS=1"), the persistent
+  * server counts requests, rows and bytes, times each stage of a request and
+  * keeps a histogram of request latencies, all served in the Prometheus text
+  * format on GET /metrics. Otherwise the macros below expand to nothing and
+  * no clock is ever read. The server is a single thread, so the counters
+  * are plain integers.
+  */
+ #ifdef SERVER_METRICS
+ 
+ enum { STAGE_PARSE, STAGE_DECODE, STAGE_RENDER, STAGE_WRITE, STAGE_COUNT };
+ 
+ static const char *const stage_names[STAGE_COUNT] = { "parse", "decode", "render", "write" };
+ 
+ /* Upper bounds of the latency histogram buckets, in seconds */
+ static const double latency_bounds[] = {
+     0.0001, 0.00025, 0.0005, 0.001, 0.0025, 0.005, 0.01, 0.025, 0.05, 0.1, 0.25, 0.5, 1, 2.5, 5, 10
+ };
+ #define LATENCY_BUCKETS (sizeof(latency_bounds) / sizeof(latency_bounds[0]))
+ 
+ typedef struct {
+     uint64_t requests;
+     uint64_t rows_evaluated;
+     uint64_t bytes_sent;
+     uint64_t streams;
+     uint64_t stage_ns[STAGE_COUNT];
+     uint64_t stage_calls[STAGE_COUNT];
+     uint64_t latency[LATENCY_BUCKETS + 1];  /* per bucket, the last one unbounded */
+     uint64_t latency_ns;
+ } Metrics;
+ 
+ static Metrics g_metrics;
+ 
+ static uint64_t metrics_clock(void) {
+     struct timespec t;
+     clock_gettime(CLOCK_MONOTONIC, &t);
+     return (uint64_t)t.tv_sec * 1000000000u + (uint64_t)t.tv_nsec;
+ }
+ 
+ /**
+  * Counts a request that took 'ns' nanoseconds to answer.
+  */
+ static void metrics_request(uint64_t ns) {
+     size_t bucket = 0;
+     while (bucket < LATENCY_BUCKETS && ns > latency_bounds[bucket] * 1e9) bucket++;
+     g_metrics.latency[bucket]++;
+     g_metrics.latency_ns += ns;
+     g_metrics.requests++;
+ }
+ 
+ #define METRICS_START(t) uint64_t t = metrics_clock()
+ #define METRICS_STAGE(stage, t) \
+     (g_metrics.stage_ns[stage] += metrics_clock() - (t), g_metrics.stage_calls[stage]++)
+ #define METRICS_ADD(counter, n) (g_metrics.counter += (n))
+ #define METRICS_REQUEST(t) metrics_request(metrics_clock() - (t))
+ 
+ #else
+ 
+ #define METRICS_START(t) ((void)0)
+ #define METRICS_STAGE(stage, t) ((void)0)
+ #define METRICS_ADD(counter, n) ((void)0)
+ #define METRICS_REQUEST(t) ((void)0)
+ 
+ #endif
  
  /* ============================ */
  /* Utility functions for CGI  */
  /* ============================ */
  
  /**
-  * Decodes a URL-encoded string.
-  * Converts '+' to space and "%XX" sequences to their character values.
+  * Returns the value of a hexadecimal digit.
+  */
+ static int hex_value(char c) {
+     return (c <= '9') ? c - '0' : (c | 0x20) - 'a' + 10;
+ }
+ 
+ /**
+  * Decodes a URL-encoded string in place.
+  * Converts '+' to space and "%XX" sequences to their character values;
+  * the decoded text is never longer than the encoded one.
   *
-  * @param src The URL-encoded source string.
-  * @return A newly allocated decoded string (caller must free it).
-  */
- char *url_decode(const char *src) {
-     char *dest = malloc(strlen(src) + 1);
-     if (!dest) return NULL;
-     char *pDest = dest;
-     while (*src) {
-         if (*src == '+') {
-             *pDest++ = ' ';
-             src++;
-         } else if (*src == '%' && isxdigit(*(src + 1)) && isxdigit(*(src + 2))) {
-             char hex[3] = { *(src + 1), *(src + 2), '\0' };
-             *pDest++ = (char) strtol(hex, NULL, 16);
-             src += 3;
+  * @param text The URL-encoded string, replaced by the decoded one.
+  */
+ static void url_decode(char *text) {
+     char *dest = text;
+     while (*text) {
+         if (*text == '+') {
+             *dest++ = ' ';
+             text++;
+         } else if (*text == '%' && isxdigit((unsigned char)text[1])
+                    && isxdigit((unsigned char)text[2])) {
+             *dest++ = (char)(hex_value(text[1]) << 4 | hex_value(text[2]));
+             text += 3;
          } else {
-             *pDest++ = *src++;
+             *dest++ = *text++;
          }
      }
-     *pDest = '\0';
-     return dest;
+     *dest = '\0';
  }
  
+ /* Parameters kept from one query string; any further ones are ignored */
+ #define MAX_QUERY_PARAMS 32
+ /* Queries shorter than this are parsed without touching the heap */
+ #define QUERY_INLINE_SIZE 1024
+ 
+ /*
+  * A query string split into its parameters in a single pass. The names
+  * and values point into one copy of the query, in which the values are
+  * decoded in place; that copy lives in the structure itself unless the
+  * query is long, so parsing a typical query allocates nothing.
+  */
+ typedef struct {
+     const char *names[MAX_QUERY_PARAMS];
+     const char *values[MAX_QUERY_PARAMS];
+     int count;
+     size_t length;       /* of the whole query, 0 if there is none */
+     char *text;          /* the copy: inline_text or a heap block */
+     char inline_text[QUERY_INLINE_SIZE];
+ } QueryParams;
+ 
  /**
-  * Extracts the value of a query parameter from the query string.
+  * Splits a query string into its key=value parameters and decodes the
+  * values. Empty pieces and pieces without '=' are skipped; of repeated
+  * names, the first one counts.
   *
-  * @param query The full query string (e.g. "expr=A+·+B&mode=tt").
-  * @param param The parameter name to extract (e.g. "expr").
-  * @return A newly allocated string with the parameter value (caller must free it),
-  *         or NULL if the parameter is not found.
+  * @param params Receives the parameters; release them with free_query.
+  * @param query The query string (e.g. "expr=A+%C2%B7+B&mode=tt"), or NULL.
+  * @return 0 on success, -1 if memory ran out.
   */
- char *get_query_param(const char *query, const char *param) {
-     char *query_dup = strdup(query);
-     if (!query_dup) return NULL;
-     char *token = strtok(query_dup, "&");
-     char *result = NULL;
-     size_t param_len = strlen(param);
-     while (token) {
-         /* token should be in the form key=value */
-         if (strncmp(token, param, param_len) == 0 && token[param_len] == '=') {
-             result = strdup(token + param_len + 1);
-             break;
+ static int parse_query(QueryParams *params, const char *query) {
+     METRICS_START(start);
+     params->count = 0;
+     params->length = query ? strlen(query) : 0;
+     params->text = params->inline_text;
+     if (params->length >= QUERY_INLINE_SIZE) {
+         params->text = malloc(params->length + 1);
+         if (!params->text) return -1;
+     }
+     memcpy(params->text, query ? query : "", params->length + 1);
+ 
+     char *p = params->text;
+     while (*p && params->count < MAX_QUERY_PARAMS) {
+         char *end = strchr(p, '&');
+         if (end) *end = '\0';
+         char *eq = strchr(p, '=');
+         if (eq) {
+             *eq = '\0';
+             params->names[params->count] = p;
+             params->values[params->count] = eq + 1;
+             params->count++;
          }
-         token = strtok(NULL, "&");
+         if (!end) break;
+         p = end + 1;
+     }
+     METRICS_STAGE(STAGE_PARSE, start);
+ 
+     METRICS_START(decode_start);
+     for (int i = 0; i < params->count; i++) {
+         url_decode((char *)params->values[i]);
+     }
+     METRICS_STAGE(STAGE_DECODE, decode_start);
+     return 0;
+ }
+ 
+ /**
+  * Looks up a parameter of a parsed query.
+  *
+  * @return Its decoded value, or NULL if the query does not have it.
+  */
+ static const char *query_param(const QueryParams *params, const char *name) {
+     for (int i = 0; i < params->count; i++) {
+         if (strcmp(params->names[i], name) == 0) return params->values[i];
      }
-     free(query_dup);
-     return result;
+     return NULL;
+ }
+ 
+ /**
+  * Releases the copy of the query that a parse may have allocated.
+  */
+ static void free_query(QueryParams *params) {
+     if (params->text != params->inline_text) free(params->text);
+ }
+ 
+ /* Response formats, chosen with the "format" parameter */
+ enum { RESPONSE_HTML, RESPONSE_JSON, RESPONSE_BINARY };
+ 
+ /**
+  * Writes text as a quoted JSON string.
+  */
+ static void write_json_string(const char *text, FILE *out) {
+     fputc('"', out);
+     for (; *text; text++) {
+         unsigned char ch = (unsigned char)*text;
+         if (ch == '"' || ch == '\\') {
+             fprintf(out, "\\%c", ch);
+         } else if (ch < 0x20) {
+             fprintf(out, "\\u%04x", ch);
+         } else {
+             fputc(ch, out);
+         }
+     }
+     fputc('"', out);
+ }
+ 
+ /**
+  * Writes text as HTML character data, escaping the characters that could
+  * start markup or end an attribute.
+  */
+ static void write_html_text(const char *text, FILE *out) {
+     for (; *text; text++) {
+         if (*text == '<') {
+             fputs("&lt;", out);
+         } else if (*text == '>') {
+             fputs("&gt;", out);
+         } else if (*text == '&') {
+             fputs("&amp;", out);
+         } else if (*text == '"') {
+             fputs("&quot;", out);
+         } else if (*text == '\'') {
+             fputs("&#39;", out);
+         } else {
+             fputc(*text, out);
+         }
+     }
+ }
+
+ /**
+  * Writes an error in a result fragment: a paragraph in HTML, an "error"
+  * member in JSON.
+  */
+ static void write_error(int format, const char *message, FILE *out) {
+     if (format == RESPONSE_HTML) {
+         fprintf(out, "<p>Error: %s</p>", message);
+         return;
+     }
+     fprintf(out, "\"error\":");
+     write_json_string(message, out);
  }
  
  /* ============================ */
- /* Boolean Expression Parser  */
+ /* Truth Table Generation       */
  /* ============================ */
  
+ /* The part of a truth table a request asks for */
+ typedef struct {
+     int filter;          /* FILTER_ value */
+     uint64_t offset;     /* first row */
+     uint64_t limit;      /* rows at most, UINT64_MAX for the rest */
+ } TableView;
+ 
+ static const TableView full_table = { FILTER_ALL, 0, UINT64_MAX };
+ 
+ /* Tables of at least this many rows are streamed by the persistent server */
+ #define STREAM_MIN_ROWS (1 << 16)
+ /* Chunks each thread evaluates per step of a streamed table */
+ #define STREAM_CHUNKS_PER_THREAD 4
+ 
  /*
-  * The parser uses a recursive descent approach with the following grammar:
+  * A truth table the persistent server sends while it is being computed.
+  * The page around the table is rendered up front; the rows are evaluated
+  * in steps of STREAM_CHUNKS_PER_THREAD chunks per thread on the
+  * parallel_truth_range pool, as fast as the connection takes them, so the
+  * first rows arrive without waiting for the last ones.
+  */
+ typedef struct {
+     Program prog;
+     uint64_t next_row;   /* first row of the next step */
+     uint64_t end_row;    /* one past the last row in view */
+     int threads;         /* threads evaluating each step */
+     TableWriter writer;
+     long page_at;        /* offset in the page where the table belongs */
+     char *tail;          /* the rest of the page, sent after the table */
+     size_t tail_len;
+     int active;          /* set once the table is deferred to the stream */
+ } TableStream;
+ 
+ /**
+  * Clamps a view to the rows of a program's table.
   *
-  *   expression = term { '+' term }
-  *   term       = factor { '·' factor }
-  *   factor     = '!' factor | '(' expression ')' | literal
-  *   literal    = '0' | '1' | variable
+  * @param first Receives the first row in view, unless it is NULL.
+  * @return The number of rows in view.
+  */
+ static uint64_t clamp_view(const Program *prog, const TableView *view, uint64_t *first) {
+     uint64_t total = 1ULL << prog->var_count;
+     uint64_t start = view->offset < total ? view->offset : total;
+     if (first) *first = start;
+     return view->limit < total - start ? view->limit : total - start;
+ }
+ 
+ /**
+  * Opens the div that wraps a page of a table, unless the view is the
+  * whole table.
   *
-  * For this CGI demonstration, any alphabetic variable is looked up
-  * in a global mapping (g_var_mapping). In evaluation mode (without a provided
-  * mapping) we assume every variable is true (1).
+  * @return Non-zero if a div was opened.
   */
+ static int open_table_page(const Program *prog, const TableView *view, FILE *out) {
+     if (view->offset == 0 && view->limit == UINT64_MAX) return 0;
+     uint64_t total = 1ULL << prog->var_count;
+     uint64_t first;
+     uint64_t rows = clamp_view(prog, view, &first);
+     fprintf(out, "<div class='truth-table' data-offset='%llu' data-rows='%llu'"
+             " data-total-rows='%llu'>", (unsigned long long)first,
+             (unsigned long long)rows, (unsigned long long)total);
+     return 1;
+ }
  
- /* Global mapping for variables.
-  * For each character (e.g., 'A' or 'b'), g_var_mapping[(int)ch] holds its Boolean value.
+ /**
+  * Generates an HTML truth table for the given Boolean expression.
+  *
+  * The expression is compiled and optimized once; the program is then run
+  * for every truth value combination of its variables in the requested
+  * range, and the results are output as an HTML table. Only that range is
+  * evaluated, so a page of a huge table costs as much as the page. A page
+  * is wrapped in a div whose data attributes give its first row, its
+  * number of rows and the size of the whole table.
+  *
+  * @param expr The Boolean expression.
+  * @param out The stream the table is written to.
+  * @param threads Number of threads evaluating the table.
+  * @param view The rows to output.
+  */
+ void generate_truth_table(const char *expr, FILE *out, int threads, const TableView *view) {
+     Program prog;
+     if (compile_expression(expr, &prog) != 0) {
+         fprintf(out, "<p>Error: Out of memory.</p>");
+         return;
+     }
+     /* Simplify once up front; every row then runs the shorter program */
+     optimize_program(&prog);
+     TableWriter writer;
+     if (writer_init(&writer, FORMAT_HTML, &prog, -1, out) != 0) {
+         fprintf(out, "<p>Error: Out of memory.</p>");
+         free_program(&prog);
+         return;
+     }
+     writer.filter = view->filter;
+ 
+     int paged = open_table_page(&prog, view, out);
+     /* Stream the table chunk by chunk; the row index is the assignment */
+     int rc = parallel_truth_range(&prog, threads, view->offset, view->limit,
+                                   writer_rows, &writer);
+     writer_finish(&writer);
+     if (paged) fprintf(out, "</div>");
+     if (rc != 0) {
+         fprintf(out, "<p>Error: Out of memory.</p>");
+     }
+     if (rc == 0) METRICS_ADD(rows_evaluated, clamp_view(&prog, view, NULL));
+     free_program(&prog);
+ }
+ 
+ /*
+  * The compact formats carry a table as a bitmap of its results, one bit
+  * per row with the first row in the least significant bit of the first
+  * byte: raw after a header with format=bin, base64-encoded in the "bitmap"
+  * member with format=json. The bitmap always holds every row in view.
   */
- static int g_var_mapping[256] = {0};
+ typedef struct {
+     FILE *out;
+     int base64;
+     unsigned pending;        /* bits not yet forming a whole byte, LSB first */
+     int pending_bits;
+     unsigned char group[3];  /* bytes waiting to be base64-encoded */
+     int group_len;
+ } BitmapWriter;
  
- /* Forward declarations for parser functions */
- static void skip_whitespace(const char **s);
- static int parse_expression(const char **s);
- static int parse_term(const char **s);
- static int parse_factor(const char **s);
+ static const char base64_digits[] =
+     "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
  
  /**
-  * Skips whitespace characters.
+  * Encodes up to three bytes as four base64 characters, padding with '='.
   */
- static void skip_whitespace(const char **s) {
-     while (**s && isspace(**s)) {
-         (*s)++;
+ static void write_base64_group(const unsigned char *bytes, int len, FILE *out) {
+     unsigned v = bytes[0] << 16 | (len > 1 ? bytes[1] << 8 : 0) | (len > 2 ? bytes[2] : 0);
+     fputc(base64_digits[v >> 18], out);
+     fputc(base64_digits[(v >> 12) & 63], out);
+     fputc(len > 1 ? base64_digits[(v >> 6) & 63] : '=', out);
+     fputc(len > 2 ? base64_digits[v & 63] : '=', out);
+ }
+ 
+ static void bitmap_byte(BitmapWriter *b, unsigned char byte) {
+     if (!b->base64) {
+         putc(byte, b->out);
+         return;
+     }
+     b->group[b->group_len++] = byte;
+     if (b->group_len == 3) {
+         write_base64_group(b->group, 3, b->out);
+         b->group_len = 0;
      }
  }
  
  /**
-  * Parses an expression (handles OR operations).
+  * ChunkCallback appending 'count' results to the bitmap. Chunks need not
+  * hold a whole number of bytes.
   */
- static int parse_expression(const char **s) {
-     int value = parse_term(s);
-     skip_whitespace(s);
-     while (**s == '+') {  /* '+' is used for OR */
-         (*s)++;  /* consume '+' */
-         skip_whitespace(s);
-         int rhs = parse_term(s);
-         value = (value || rhs) ? 1 : 0;
-         skip_whitespace(s);
+ static void bitmap_rows(void *ctx, uint64_t first, uint64_t count, const uint64_t *results) {
+     BitmapWriter *b = ctx;
+     (void)first;
+     for (uint64_t k = 0; k < count; k += 8) {
+         int n = count - k < 8 ? (int)(count - k) : 8;
+         unsigned bits = (unsigned)(results[k / 64] >> (k % 64)) & ((1u << n) - 1);
+         b->pending |= bits << b->pending_bits;
+         b->pending_bits += n;
+         if (b->pending_bits >= 8) {
+             bitmap_byte(b, (unsigned char)b->pending);
+             b->pending >>= 8;
+             b->pending_bits -= 8;
+         }
      }
-     return value;
  }
  
  /**
-  * Parses a term (handles AND operations).
+  * Writes the last partial byte and base64 group of a bitmap.
   */
- static int parse_term(const char **s) {
-     int value = parse_factor(s);
-     skip_whitespace(s);
-     while (**s == '·') {  /* '·' is used for AND */
-         (*s)++;  /* consume '·' */
-         skip_whitespace(s);
-         int rhs = parse_factor(s);
-         value = (value && rhs) ? 1 : 0;
-         skip_whitespace(s);
-     }
-     return value;
+ static void bitmap_finish(BitmapWriter *b) {
+     if (b->pending_bits > 0) bitmap_byte(b, (unsigned char)b->pending);
+     if (b->group_len > 0) write_base64_group(b->group, b->group_len, b->out);
  }
  
  /**
-  * Parses a factor (handles NOT, parentheses, and literals).
+  * Writes a truth table of the given Boolean expression as a bitmap.
+  *
+  * In JSON the fragment gives the variables, the first row, the number of
+  * rows and of rows in the whole table, and the base64 bitmap. The binary
+  * format has the layout of the solver's "--format binary": "BTT1", the
+  * variable count (1 byte), the variable names, the number of rows in view
+  * (8 bytes, little-endian), then the raw bitmap. The binary table is built
+  * in memory and written only once it is complete.
+  *
+  * @param expr The Boolean expression.
+  * @param format RESPONSE_JSON or RESPONSE_BINARY.
+  * @param out The stream the table is written to.
+  * @param threads Number of threads evaluating the table.
+  * @param view The rows to output; its filter does not apply.
+  * @return 0 on success or once a JSON fragment has reported the error, -1
+  *         if memory ran out for a binary table, of which nothing is written.
   */
- static int parse_factor(const char **s) {
-     skip_whitespace(s);
-     int value = 0;
-     if (**s == '!') {
-         (*s)++;  /* consume '!' */
-         int factor_val = parse_factor(s);
-         value = (!factor_val) ? 1 : 0;
-     } else if (**s == '(') {
-         (*s)++;  /* consume '(' */
-         value = parse_expression(s);
-         skip_whitespace(s);
-         if (**s == ')') {
-             (*s)++;  /* consume ')' */
+ int write_truth_bitmap(const char *expr, int format, FILE *out, int threads,
+                        const TableView *view) {
+     Program prog;
+     if (compile_expression(expr, &prog) != 0) {
+         if (format == RESPONSE_BINARY) return -1;
+         write_error(format, "Out of memory.", out);
+         return 0;
+     }
+     optimize_program(&prog);
+     uint64_t total = 1ULL << prog.var_count;
+     uint64_t first;
+     uint64_t rows = clamp_view(&prog, view, &first);
+ 
+     if (format == RESPONSE_BINARY) {
+         char *bits = NULL;
+         size_t bits_len = 0;
+         FILE *mem = open_memstream(&bits, &bits_len);
+         if (!mem) {
+             free_program(&prog);
+             return -1;
+         }
+         BitmapWriter bitmap = { .out = mem };
+         int rc = parallel_truth_range(&prog, threads, first, rows, bitmap_rows, &bitmap);
+         bitmap_finish(&bitmap);
+         if (fclose(mem) == 0 && rc == 0) {
+             fwrite("BTT1", 1, 4, out);
+             fputc(prog.var_count, out);
+             fwrite(prog.vars, 1, prog.var_count, out);
+             for (int i = 0; i < 8; i++) fputc((int)(rows >> (8 * i)) & 0xff, out);
+             fwrite(bits, 1, bits_len, out);
+             METRICS_ADD(rows_evaluated, rows);
          } else {
-             fprintf(stderr, "Error: Missing closing parenthesis.\n");
+             rc = -1;
          }
-     } else if (isdigit(**s)) {
-         value = **s - '0';
-         (*s)++;
-     } else if (isalpha(**s)) {
-         /* For any variable, look up its value from g_var_mapping */
-         char var = **s;
-         (*s)++;
-         value = g_var_mapping[(int)var];
+         free(bits);
+         free_program(&prog);
+         return rc;
+     }
+ 
+     fprintf(out, "\"variables\":[");
+     for (int j = 0; j < prog.var_count; j++) {
+         fprintf(out, "%s\"%c\"", j ? "," : "", prog.vars[j]);
      }
-     return value;
+     fprintf(out, "],\"offset\":%llu,\"rows\":%llu,\"total_rows\":%llu,\"bitmap\":\"",
+             (unsigned long long)first, (unsigned long long)rows,
+             (unsigned long long)total);
+     BitmapWriter bitmap = { .out = out, .base64 = 1 };
+     int rc = parallel_truth_range(&prog, threads, first, rows, bitmap_rows, &bitmap);
+     bitmap_finish(&bitmap);
+     fputc('"', out);
+     if (rc != 0) {
+         fputc(',', out);
+         write_error(format, "Out of memory.", out);
+     } else {
+         METRICS_ADD(rows_evaluated, rows);
+     }
+     free_program(&prog);
+     return 0;
  }
  
  /**
-  * Evaluates a Boolean expression.
-  * Assumes that any variable is true (1) by default.
+  * Prepares a truth table to be streamed instead of rendered, if it has at
+  * least STREAM_MIN_ROWS rows in view. Only the wrapping div, if any, is
+  * written to the page; the position of the table in it is recorded.
   *
-  * @param expr The Boolean expression as a string.
-  * @return The evaluated Boolean result (0 or 1).
+  * @param s The stream, with its active flag clear.
+  * @param expr The Boolean expression.
+  * @param view The rows to output.
+  * @param threads Number of threads evaluating the table.
+  * @param out The stream the page is written to.
+  * @return 1 if the table will be streamed, 0 if it should be rendered as
+  *         usual, -1 if memory ran out.
+  */
+ static int open_table_stream(TableStream *s, const char *expr, const TableView *view,
+                              int threads, FILE *out) {
+     /* Errors are left for generate_truth_table to report */
+     if (compile_expression(expr, &s->prog) != 0) return 0;
+     optimize_program(&s->prog);
+     uint64_t rows = clamp_view(&s->prog, view, &s->next_row);
+     if (rows < STREAM_MIN_ROWS) {
+         free_program(&s->prog);
+         return 0;
+     }
+     s->end_row = s->next_row + rows;
+     s->threads = threads;
+     if (writer_init(&s->writer, FORMAT_HTML, &s->prog, -1, out) != 0) {
+         free(s->writer.buf);
+         free_program(&s->prog);
+         return -1;
+     }
+     s->writer.filter = view->filter;
+ 
+     int paged = open_table_page(&s->prog, view, out);
+     s->page_at = ftell(out);
+     if (paged) fprintf(out, "</div>");
+     s->active = 1;
+     return 1;
+ }
+ 
+ /**
+  * Releases a stream and everything it holds.
   */
- int evaluate_boolean_expression(const char *expr) {
-     /* Set default mapping: every variable is assumed true */
-     for (int i = 0; i < 256; i++) {
-         g_var_mapping[i] = 1;
+ static void free_table_stream(TableStream *s) {
+     if (s->active) {
+         free(s->writer.buf);
+         free_program(&s->prog);
      }
-     const char *p = expr;
-     int result = parse_expression(&p);
-     return result;
+     free(s->tail);
+     free(s);
  }
  
  /**
-  * Evaluates a Boolean expression using a provided variable mapping.
+  * Writes a minimal sum of products and product of sums for the given
+  * Boolean expression.
   *
-  * @param expr The Boolean expression as a string.
-  * @param mapping An array of 256 ints mapping each character to its Boolean value.
-  * @return The evaluated Boolean result (0 or 1).
+  * @param expr The Boolean expression.
+  * @param format RESPONSE_HTML or RESPONSE_JSON.
+  * @param out The stream the result is written to.
+  * @param threads Number of threads evaluating its truth table.
   */
- int evaluate_expr_with_mapping(const char *expr, int mapping[256]) {
-     memcpy(g_var_mapping, mapping, sizeof(g_var_mapping));
-     const char *p = expr;
-     int result = parse_expression(&p);
-     return result;
+ void simplify_expression(const char *expr, int format, FILE *out, int threads) {
+     Program prog;
+     if (compile_expression(expr, &prog) != 0) {
+         write_error(format, "Out of memory.", out);
+         return;
+     }
+     if (prog.var_count > MINIMIZE_MAX_VARS) {
+         char message[64];
+         snprintf(message, sizeof(message), "Simplification supports at most %d variables.",
+                  MINIMIZE_MAX_VARS);
+         write_error(format, message, out);
+         free_program(&prog);
+         return;
+     }
+     optimize_program(&prog);
+     Cover sop, pos;
+     int rc = minimize_program(&prog, threads, &sop, &pos);
+     free_program(&prog);
+     if (rc != 0) {
+         write_error(format, "Out of memory.", out);
+         return;
+     }
+     /* Covers print only variable names and operators, nothing to escape */
+     fprintf(out, format == RESPONSE_HTML ? "<p>Sum of products: " : "\"sop\":\"");
+     write_cover(&sop, 0, out);
+     fprintf(out, format == RESPONSE_HTML ? "</p><p>Product of sums: " : "\",\"pos\":\"");
+     write_cover(&pos, 1, out);
+     fprintf(out, format == RESPONSE_HTML ? "</p>" : "\"");
+     free_cover(&sop);
+     free_cover(&pos);
  }
  
  /* ============================ */
- /* Truth Table Generation       */
+ /* BDD Queries                  */
  /* ============================ */
  
  /**
-  * Generates an HTML truth table for the given Boolean expression.
-  *
-  * The function first extracts all unique alphabetic variables from the expression,
-  * then iterates over all possible truth value combinations, evaluates the expression
-  * for each combination, and outputs an HTML table.
+  * Writes an assignment of a query's variables as "A=1, B=0", or in JSON as
+  * {"A":1,"B":0}.
+  */
+ static void write_model(const BddResult *r, int format, FILE *out) {
+     int json = format != RESPONSE_HTML;
+     if (json) fputc('{', out);
+     for (int j = 0; j < r->var_count; j++) {
+         int value = (int)(r->model >> (r->var_count - j - 1)) & 1;
+         if (json) {
+             fprintf(out, "%s\"%c\":%d", j ? "," : "", r->vars[j], value);
+         } else {
+             fprintf(out, "%s%c=%d", j ? ", " : "", r->vars[j], value);
+         }
+     }
+     if (json) fputc('}', out);
+ }
+ 
+ /**
+  * Answers a satisfiability or counting query with a BDD, which needs no
+  * truth table and so handles expressions with far more variables than a
+  * table could, or an equivalence or tautology query with
+  * check_equivalence, which stops at the first counterexample. The number
+  * of counterexamples is only known, and reported, when a BDD answered.
   *
+  * @param mode 's' for satisfiability, 'c' for counting, 'q' for
+  *        equivalence, 'a' for a tautology.
+  * @param format RESPONSE_HTML or RESPONSE_JSON.
   * @param expr The Boolean expression.
+  * @param expr2 The expression to compare it with in equivalence mode.
+  * @param threads Number of threads sweeping the truth table.
+  * @param out The stream the answer is written to.
   */
- void generate_truth_table(const char *expr) {
-     /* Identify unique variables in the expression */
-     char vars[100];
-     int var_count = 0;
-     memset(vars, 0, sizeof(vars));
-     for (const char *p = expr; *p; p++) {
-         if (isalpha(*p)) {
-             char ch = *p;
-             int already = 0;
-             for (int i = 0; i < var_count; i++) {
-                 if (vars[i] == ch) {
-                     already = 1;
-                     break;
-                 }
-             }
-             if (!already && var_count < 100) {
-                 vars[var_count++] = ch;
-             }
+ void answer_query(char mode, int format, const char *expr, const char *expr2, int threads,
+                   FILE *out) {
+     BddResult r;
+     int rc = mode == 'q' || mode == 'a'
+              ? check_equivalence(expr, mode == 'q' ? expr2 : NULL, threads, &r)
+              : bdd_analyze(expr, NULL, &r);
+     if (rc != 0) {
+         write_error(format, "Expression too large for a BDD or out of memory.", out);
+         return;
+     }
+     unsigned long long total = 1ULL << r.var_count;
+ 
+     if (format != RESPONSE_HTML) {
+         if (mode == 's') {
+             fprintf(out, "\"satisfiable\":%s", r.found ? "true" : "false");
+         } else if (mode == 'c') {
+             fprintf(out, "\"count\":%llu", (unsigned long long)r.count);
+         } else if (mode == 'q') {
+             fprintf(out, "\"equivalent\":%s", r.found ? "false" : "true");
+         } else {
+             fprintf(out, "\"tautology\":%s", r.found ? "false" : "true");
          }
+         if (mode != 'c' && r.found) {
+             fprintf(out, mode == 's' ? ",\"model\":" : ",\"counterexample\":");
+             write_model(&r, format, out);
+         }
+         if (mode == 'q' && r.found) {
+             fprintf(out, ",\"values\":[%d,%d]", r.value, !r.value);
+         }
+         if ((mode == 'q' || mode == 'a') && r.found && r.counted) {
+             fprintf(out, ",\"differing\":%llu", (unsigned long long)r.count);
+         }
+         if (mode != 's') fprintf(out, ",\"total\":%llu", total);
+         return;
+     }
+ 
+     if (mode == 's') {
+         if (!r.found) {
+             fprintf(out, "<p>Unsatisfiable</p>");
+             return;
+         }
+         fprintf(out, "<p>Satisfiable%s", r.var_count ? ": " : "");
+         write_model(&r, format, out);
+         fprintf(out, "</p>");
+     } else if (mode == 'c') {
+         fprintf(out, "<p>Satisfying assignments: %llu of %llu</p>",
+                 (unsigned long long)r.count, total);
+     } else if (!r.found) {
+         fprintf(out, mode == 'q' ? "<p>Equivalent</p>" : "<p>Tautology</p>");
+     } else if (mode == 'q') {
+         fprintf(out, "<p>Not equivalent: ");
+         write_model(&r, format, out);
+         fprintf(out, " gives %d and %d", r.value, !r.value);
+         if (r.counted) {
+             fprintf(out, " (%llu of %llu assignments differ)", (unsigned long long)r.count, total);
+         }
+         fprintf(out, "</p>");
+     } else {
+         fprintf(out, "<p>Not a tautology%s", r.var_count ? ": " : "");
+         write_model(&r, format, out);
+         if (r.var_count) fprintf(out, " gives 0");
+         if (r.counted) {
+             fprintf(out, " (%llu of %llu assignments give 0)", (unsigned long long)r.count, total);
+         }
+         fprintf(out, "</p>");
      }
+ }
+ 
+ /* ============================ */
+ /* Response Cache               */
+ /* ============================ */
+ 
+ /*
+  * The persistent server remembers the rendered result of recent requests,
+  * keyed on the canonical request: the mode, the assignment list and the
+  * expression, each with whitespace removed. Entries live in a hash table
+  * and on an LRU list; the least recently used ones are evicted whenever
+  * the total size would exceed the configured limit. The server is a single
+  * epoll thread, so the cache needs no locking.
+  */
+ 
+ typedef struct CacheEntry {
+     struct CacheEntry *hash_next;
+     struct CacheEntry *prev;   /* LRU neighbours, most recent at the head */
+     struct CacheEntry *next;
+     uint64_t hash;
+     char *key;
+     size_t key_len;
+     char *value;               /* rendered result fragment */
+     size_t value_len;
+ } CacheEntry;
+ 
+ typedef struct {
+     CacheEntry **buckets;
+     size_t bucket_count;       /* always a power of two */
+     CacheEntry *head;
+     CacheEntry *tail;
+     size_t entries;
+     size_t bytes;              /* keys, values and entry overhead */
+     size_t max_bytes;
+     uint64_t hits;
+     uint64_t misses;
+     uint64_t evictions;
+ } ResponseCache;
  
-     /* Output the start of an HTML table */
-     printf("<table border='1' cellpadding='5' cellspacing='0'>");
-     printf("<tr>");
-     for (int i = 0; i < var_count; i++) {
-         printf("<th>%c</th>", vars[i]);
+ /**
+  * FNV-1a hash of a byte string.
+  */
+ static uint64_t hash_bytes(const char *data, size_t len) {
+     uint64_t h = 14695981039346656037ULL;
+     for (size_t i = 0; i < len; i++) {
+         h = (h ^ (unsigned char)data[i]) * 1099511628211ULL;
      }
-     printf("<th>Result</th></tr>");
+     return h;
+ }
  
-     int total_rows = 1 << var_count;
-     /* Iterate over every combination of truth values */
-     for (int i = 0; i < total_rows; i++) {
-         int mapping[256];
-         /* Set default: all variables to true */
-         for (int j = 0; j < 256; j++) {
-             mapping[j] = 1;
+ /**
+  * Prepares an empty cache holding at most max_bytes; 0 disables caching.
+  */
+ static void cache_init(ResponseCache *cache, size_t max_bytes) {
+     memset(cache, 0, sizeof(*cache));
+     cache->max_bytes = max_bytes;
+ }
+ 
+ static size_t entry_size(const CacheEntry *e) {
+     return sizeof(CacheEntry) + e->key_len + e->value_len;
+ }
+ 
+ static void lru_unlink(ResponseCache *cache, CacheEntry *e) {
+     if (e->prev) e->prev->next = e->next; else cache->head = e->next;
+     if (e->next) e->next->prev = e->prev; else cache->tail = e->prev;
+     e->prev = e->next = NULL;
+ }
+ 
+ static void lru_push_front(ResponseCache *cache, CacheEntry *e) {
+     e->prev = NULL;
+     e->next = cache->head;
+     if (cache->head) cache->head->prev = e; else cache->tail = e;
+     cache->head = e;
+ }
+ 
+ /**
+  * Removes the least recently used entry.
+  */
+ static void cache_evict(ResponseCache *cache) {
+     CacheEntry *e = cache->tail;
+     CacheEntry **link = &cache->buckets[e->hash & (cache->bucket_count - 1)];
+     while (*link != e) link = &(*link)->hash_next;
+     *link = e->hash_next;
+     lru_unlink(cache, e);
+     cache->entries--;
+     cache->bytes -= entry_size(e);
+     cache->evictions++;
+     free(e->key);
+     free(e->value);
+     free(e);
+ }
+ 
+ /**
+  * Finds the entry of a key whose hash is h.
+  *
+  * @return The entry, or NULL if the key is not cached.
+  */
+ static CacheEntry *cache_find(const ResponseCache *cache, const char *key, size_t key_len,
+                               uint64_t h) {
+     if (cache->bucket_count == 0) return NULL;
+     for (CacheEntry *e = cache->buckets[h & (cache->bucket_count - 1)]; e; e = e->hash_next) {
+         if (e->hash == h && e->key_len == key_len && memcmp(e->key, key, key_len) == 0) {
+             return e;
          }
-         /* For each unique variable, assign a value based on the current combination */
-         for (int j = 0; j < var_count; j++) {
-             /* The leftmost variable corresponds to the highest-order bit */
-             mapping[(int)vars[j]] = ((i >> (var_count - j - 1)) & 1);
+     }
+     return NULL;
+ }
+
+ /**
+  * Looks up a key and marks the entry as most recently used.
+  *
+  * @return The entry, or NULL on a miss.
+  */
+ static CacheEntry *cache_lookup(ResponseCache *cache, const char *key, size_t key_len) {
+     CacheEntry *e = cache_find(cache, key, key_len, hash_bytes(key, key_len));
+     if (e == NULL) {
+         cache->misses++;
+         return NULL;
+     }
+     lru_unlink(cache, e);
+     lru_push_front(cache, e);
+     cache->hits++;
+     return e;
+ }
+
+ /**
+  * Stores a copy of a rendered fragment, evicting old entries to make room.
+  * Values too large for the cache, or keys already present, are ignored.
+  */
+ static void cache_insert(ResponseCache *cache, const char *key, size_t key_len,
+                          const char *value, size_t value_len) {
+     size_t size = sizeof(CacheEntry) + key_len + value_len;
+     uint64_t h = hash_bytes(key, key_len);
+     if (size > cache->max_bytes || cache_find(cache, key, key_len, h)) return;
+ 
+     /* Keep the load factor at or below one */
+     if (cache->entries + 1 > cache->bucket_count) {
+         size_t count = cache->bucket_count ? cache->bucket_count * 2 : 64;
+         CacheEntry **buckets = calloc(count, sizeof(CacheEntry *));
+         if (!buckets) return;
+         for (size_t i = 0; i < cache->bucket_count; i++) {
+             CacheEntry *e = cache->buckets[i];
+             while (e) {
+                 CacheEntry *next = e->hash_next;
+                 e->hash_next = buckets[e->hash & (count - 1)];
+                 buckets[e->hash & (count - 1)] = e;
+                 e = next;
+             }
          }
-         int result = evaluate_expr_with_mapping(expr, mapping);
-         /* Output a table row */
-         printf("<tr>");
-         for (int j = 0; j < var_count; j++) {
-             int val = mapping[(int)vars[j]];
-             printf("<td>%d</td>", val);
+         free(cache->buckets);
+         cache->buckets = buckets;
+         cache->bucket_count = count;
+     }
+ 
+     CacheEntry *e = calloc(1, sizeof(CacheEntry));
+     if (e) {
+         e->key = malloc(key_len);
+         e->value = malloc(value_len ? value_len : 1);
+     }
+     if (!e || !e->key || !e->value) {
+         if (e) {
+             free(e->key);
+             free(e->value);
          }
-         printf("<td>%d</td>", result);
-         printf("</tr>");
+         free(e);
+         return;
      }
-     printf("</table>");
+     memcpy(e->key, key, key_len);
+     memcpy(e->value, value, value_len);
+     e->key_len = key_len;
+     e->value_len = value_len;
+     e->hash = h;
+ 
+     while (cache->bytes + size > cache->max_bytes) cache_evict(cache);
+     CacheEntry **bucket = &cache->buckets[e->hash & (cache->bucket_count - 1)];
+     e->hash_next = *bucket;
+     *bucket = e;
+     lru_push_front(cache, e);
+     cache->entries++;
+     cache->bytes += size;
+ }
+ 
+ /**
+  * Copies 'text' into 'dest' without whitespace and returns the new length.
+  */
+ static size_t strip_whitespace(char *dest, const char *text) {
+     size_t n = 0;
+     for (; *text; text++) {
+         if (!isspace((unsigned char)*text)) dest[n++] = *text;
+     }
+     dest[n] = '\0';
+     return n;
  }
  
  /* ============================ */
- /* Main CGI Function          */
+ /* Request Handling             */
  /* ============================ */
  
- int main(void) {
-     /* Output the HTTP header */
-     printf("Content-Type: text/html\n\n");
+ /* Process-wide settings, fixed at startup from the command line or the
+  * environment and only read afterwards. */
+ typedef struct {
+     int threads;         /* threads evaluating each truth table */
+     size_t cache_bytes;  /* result cache limit in persistent mode */
+ } ServerConfig;
+ 
+ static ServerConfig g_config = { 1, 64 << 20 };
+ 
+ /**
+  * Renders the part of a page that depends only on the canonical request:
+  * the truth table in "tt" mode, the minimal forms in "simplify" mode, the
+  * answer of a query in the "sat", "count", "equiv" and "tautology" modes,
+  * otherwise the evaluation result.
+  *
+  * @param mode The mode's key character (see parse_mode).
+  * @param format The RESPONSE_ format of the fragment.
+  * @param view The part of a truth table to render.
+  * @param expr The canonical expression.
+  * @param assignments The canonical assignment list, or the second
+  *        expression in equivalence mode; NULL if there is none.
+  * @param out The stream the fragment is written to.
+  * @return 0 once the fragment, or the error it reports, is written; -1 if
+  *         memory ran out for a binary table, of which nothing is written.
+  */
+ static int render_result(char mode, int format, const TableView *view, const char *expr,
+                          const char *assignments, FILE *out) {
+     if (mode == 't') {
+         if (format == RESPONSE_HTML) {
+             generate_truth_table(expr, out, g_config.threads, view);
+             return 0;
+         }
+         return write_truth_bitmap(expr, format, out, g_config.threads, view);
+     }
+     if (mode == 'm') {
+         simplify_expression(expr, format, out, g_config.threads);
+         return 0;
+     }
+     if (mode != 'e') {
+         answer_query(mode, format, expr, assignments, g_config.threads, out);
+         return 0;
+     }
+     int result;
+     int rc = evaluate_with_assignments(expr, assignments, &result);
+     if (rc != 0) {
+         const char *message = rc == -1 ? "Invalid variable assignments." : "Out of memory.";
+         if (format == RESPONSE_HTML) {
+             fprintf(out, "<h2>Error: %s</h2>", message);
+         } else {
+             write_error(format, message, out);
+         }
+     } else if (format == RESPONSE_HTML) {
+         if (assignments) {
+             fprintf(out, "<p>Assignments: ");
+             write_html_text(assignments, out);
+             fprintf(out, "</p>");
+         }
+         fprintf(out, "<p>Result: %d</p>", result);
+     } else {
+         if (assignments) {
+             fprintf(out, "\"assignments\":");
+             write_json_string(assignments, out);
+             fputc(',', out);
+         }
+         fprintf(out, "\"result\":%d", result);
+     }
+     return 0;
+ }
+ 
+ /**
+  * Writes the result fragment for a request, answering from the cache when
+  * one is given and it holds the canonical request. A large truth table is
+  * instead deferred to 'stream' when one is given; it is never cached, and
+  * neither is a binary table that could not be built.
+  *
+  * @return 0 on success, -1 if memory ran out.
+  */
+ static int emit_result(ResponseCache *cache, TableStream *stream, char mode, int format,
+                        const TableView *view, const char *expr,
+                        const char *assignments, FILE *out) {
+     /* Key: mode, format, table view, assignments (or expr2) and expression,
+      * without whitespace */
+     size_t expr_len = strlen(expr);
+     size_t assign_len = assignments ? strlen(assignments) : 0;
+     char *key = malloc(expr_len + assign_len + 64);
+     if (!key) return -1;
+     size_t key_len = (size_t)sprintf(key, "%c%d%d:%llu:%llu\n", mode, format, view->filter,
+                                      (unsigned long long)view->offset,
+                                      (unsigned long long)view->limit);
+     char *canonical_assign = key + key_len;
+     key_len += strip_whitespace(canonical_assign, assignments ? assignments : "");
+     key[key_len++] = '\n';
+     char *canonical_expr = key + key_len;
+     key_len += strip_whitespace(canonical_expr, expr);
+ 
+     if (stream && mode == 't' && format == RESPONSE_HTML) {
+         int rc = open_table_stream(stream, canonical_expr, view, g_config.threads, out);
+         if (rc != 0) {
+             free(key);
+             return rc < 0 ? -1 : 0;
+         }
+     }
+     if (cache && cache->max_bytes > 0) {
+         CacheEntry *hit = cache_lookup(cache, key, key_len);
+         if (hit) {
+             fwrite(hit->value, 1, hit->value_len, out);
+             free(key);
+             return 0;
+         }
+     }
+ 
+     /* Render from the canonical text; the assignment part of the key is
+      * terminated in place for the duration */
+     canonical_expr[-1] = '\0';
+     const char *canonical = assignments ? canonical_assign : NULL;
+     if (!cache || cache->max_bytes == 0) {
+         METRICS_START(start);
+         int rc = render_result(mode, format, view, canonical_expr, canonical, out);
+         METRICS_STAGE(STAGE_RENDER, start);
+         free(key);
+         return rc;
+     }
+     char *fragment = NULL;
+     size_t fragment_len = 0;
+     FILE *mem = open_memstream(&fragment, &fragment_len);
+     if (!mem) {
+         free(key);
+         return -1;
+     }
+     METRICS_START(start);
+     int rc = render_result(mode, format, view, canonical_expr, canonical, mem);
+     fclose(mem);
+     METRICS_STAGE(STAGE_RENDER, start);
+     canonical_expr[-1] = '\n';
+     fwrite(fragment, 1, fragment_len, out);
+     if (rc == 0) cache_insert(cache, key, key_len, fragment, fragment_len);
+     free(fragment);
+     free(key);
+     return rc;
+ }
+ 
+ /**
+  * Maps the "mode" parameter to the character that stands for it in cache
+  * keys: 't' for "tt", 'm' for "simplify", 's' for "sat", 'c' for "count",
+  * 'q' for "equiv", 'a' for "tautology" and 'e' (evaluation) for anything
+  * else.
+  */
+ static char parse_mode(const char *name) {
+     if (name == NULL) return 'e';
+     if (strcmp(name, "tt") == 0) return 't';
+     if (strcmp(name, "simplify") == 0) return 'm';
+     if (strcmp(name, "sat") == 0) return 's';
+     if (strcmp(name, "count") == 0) return 'c';
+     if (strcmp(name, "equiv") == 0) return 'q';
+     if (strcmp(name, "tautology") == 0) return 'a';
+     return 'e';
+ }
+ 
+ /**
+  * Parses a row number parameter such as "offset" or "limit".
+  *
+  * @return 0 on success, -1 unless the text is a plain decimal number.
+  */
+ static int parse_row_number(const char *text, uint64_t *value) {
+     if (text == NULL || *text < '0' || *text > '9') return -1;
+     char *end;
+     errno = 0;
+     unsigned long long n = strtoull(text, &end, 10);
+     if (*end != '\0' || errno == ERANGE) return -1;
+     *value = n;
+     return 0;
+ }
+ 
+ /**
+  * Parses a numeric command-line option or environment setting.
+  *
+  * @param text The decimal number.
+  * @param min The smallest value accepted.
+  * @param max The largest value accepted.
+  * @param value Receives the number.
+  * @return 0 on success, -1 unless the text is a number from min to max.
+  */
+ static int parse_option_number(const char *text, long min, long max, long *value) {
+     char *end;
+     errno = 0;
+     long n = strtol(text, &end, 10);
+     if (end == text || *end != '\0' || errno == ERANGE || n < min || n > max) return -1;
+     *value = n;
+     return 0;
+ }
+
+ /**
+  * Picks the response format from the query's "format" parameter: "json",
+  * or "bin" for a truth table (and JSON for anything else), otherwise HTML.
+  */
+ static int response_format(const QueryParams *params) {
+     const char *name = query_param(params, "format");
+     if (name && strcmp(name, "json") == 0) return RESPONSE_JSON;
+     if (name && strcmp(name, "bin") == 0) {
+         return parse_mode(query_param(params, "mode")) == 't' ? RESPONSE_BINARY : RESPONSE_JSON;
+     }
+     return RESPONSE_HTML;
+ }
+ 
+ /**
+  * Returns the Content-Type of a response format.
+  */
+ static const char *response_content_type(int format) {
+     if (format == RESPONSE_JSON) return "application/json";
+     if (format == RESPONSE_BINARY) return "application/octet-stream";
+     return "text/html";
+ }
+ 
+ /**
+  * Ends a page with an error heading, or a JSON response with an "error"
+  * member (the binary format reports errors this way too).
+  *
+  * @param open Non-zero if the JSON object has already been started.
+  * @return 1, the result of handle_query for an unusable query.
+  */
+ static int fail_query(int format, int open, const char *message, FILE *out) {
+     if (format == RESPONSE_HTML) {
+         fprintf(out, "<h2>Error: %s</h2>", message);
+         fprintf(out, "</body></html>");
+     } else {
+         fputc(open ? ',' : '{', out);
+         write_error(format, message, out);
+         fprintf(out, "}\n");
+     }
+     return 1;
+ }
+ 
+ /**
+  * Renders the HTML page answering one query string.
+  *
+  * This is the whole per-request pipeline (evaluation and output of the
+  * parsed, decoded parameters) shared by the CGI entry point and the
+  * persistent server. All state lives on the stack or in the compiled
+  * program, so requests never share anything except the optional result
+  * cache.
+  *
+  * @param params The parsed query string.
+  * @param out The stream the page is written to.
+  * @param cache The result cache, or NULL to always render.
+  * @param stream A stream a large truth table may be deferred to (its
+  *        active flag is then set), or NULL to always render.
+  * @return 0 on success, 1 if the query was unusable, -1 if memory ran out
+  *         for a binary response, of which nothing is then written.
+  */
+ int handle_query(const QueryParams *params, FILE *out, ResponseCache *cache,
+                  TableStream *stream) {
+     /* Optional "format" parameter: "json" or "bin" instead of a page */
+     int format = response_format(params);
+     int html = format == RESPONSE_HTML;
  
      /* Begin HTML output */
-     printf("<html><head><title>Boolean Expression Solver Result</title></head><body>");
-     printf("<h1>Boolean Expression Solver (C Backend)</h1>");
- 
-     /* Retrieve the QUERY_STRING from the environment */
-     char *query = getenv("QUERY_STRING");
-     if (query == NULL || strlen(query) == 0) {
-         printf("<h2>Error: No query string provided.</h2>");
-         printf("</body></html>");
-         return 1;
+     if (html) {
+         fprintf(out, "<html><head><title>Boolean Expression Solver Result</title></head><body>");
+         fprintf(out, "<h1>Boolean Expression Solver (C Backend)</h1>");
      }
  
-     /* Extract the "expr" parameter */
-     char *expr_param = get_query_param(query, "expr");
-     if (expr_param == NULL) {
-         printf("<h2>Error: No expression provided.</h2>");
-         printf("</body></html>");
-         return 1;
+     if (params->length == 0) {
+         return fail_query(format, 0, "No query string provided.", out);
      }
-     /* URL-decode the expression */
-     char *decoded_expr = url_decode(expr_param);
-     free(expr_param);
-     if (decoded_expr == NULL) {
-         printf("<h2>Error: Failed to decode expression.</h2>");
-         printf("</body></html>");
-         return 1;
+ 
+     /* The "expr" parameter, already URL-decoded */
+     const char *expr = query_param(params, "expr");
+     if (expr == NULL) {
+         return fail_query(format, 0, "No expression provided.", out);
      }
  
      /* Check for an optional "mode" parameter:
-      * If mode is "tt", then generate a truth table.
-      * Otherwise, perform a simple evaluation.
+      * If mode is "tt", then generate a truth table; "simplify" minimizes
+      * it, "sat" and "count" answer a BDD query, and "equiv" and
+      * "tautology" look for a counterexample. Otherwise, perform a simple
+      * evaluation.
       */
-     char *mode_param = get_query_param(query, "mode");
+     char mode = parse_mode(query_param(params, "mode"));
+     /* Optional "filter" parameter: "true" or "false" keeps only the
+      * truth-table rows with that result */
+     TableView view = full_table;
+     const char *view_error = NULL;
+     if (mode == 't') {
+         const char *filter = query_param(params, "filter");
+         if (filter && (view.filter = parse_filter(filter)) < 0) {
+             view_error = "Invalid filter.";
+         }
+         /* Optional "offset" and "limit" parameters select a page of rows */
+         const char *offset = query_param(params, "offset");
+         const char *limit = query_param(params, "limit");
+         if ((offset && parse_row_number(offset, &view.offset) != 0)
+             || (limit && parse_row_number(limit, &view.limit) != 0)) {
+             view_error = "Invalid offset or limit.";
+         }
+         /* A bitmap holds every row */
+         if (!html) view.filter = FILTER_ALL;
+     }
+     /* Optional "assign" parameter, e.g. "A=0,B=1"; others default to 1.
+      * Equivalence mode takes the second expression from "expr2" instead. */
+     const char *assignments = mode == 'e' ? query_param(params, "assign")
+                             : mode == 'q' ? query_param(params, "expr2") : NULL;
+ 
+     if (!html) {
+         /* The binary format is the bare bitmap */
+         if (format == RESPONSE_JSON) {
+             fprintf(out, "{\"expression\":");
+             write_json_string(expr, out);
+         }
+     } else if (mode == 't') {
+         fprintf(out, "<h2>Truth Table for Expression:</h2>");
+     } else if (mode == 'm') {
+         fprintf(out, "<h2>Simplified Forms of Expression:</h2>");
+     } else if (mode == 's') {
+         fprintf(out, "<h2>Satisfiability of Expression:</h2>");
+     } else if (mode == 'c') {
+         fprintf(out, "<h2>Satisfying Assignments of Expression:</h2>");
+     } else if (mode == 'q') {
+         fprintf(out, "<h2>Equivalence of Expressions:</h2>");
+     } else if (mode == 'a') {
+         fprintf(out, "<h2>Tautology Check of Expression:</h2>");
+     } else {
+         fprintf(out, "<h2>Evaluation Result for Expression:</h2>");
+     }
+     if (html) {
+         fprintf(out, "<p>");
+         write_html_text(expr, out);
+         fprintf(out, "</p>");
+     }
+     if (view_error) {
+         return fail_query(format, format == RESPONSE_JSON, view_error, out);
+     }
+     if (mode == 'q') {
+         if (assignments == NULL) {
+             return fail_query(format, 1, "No second expression provided.", out);
+         }
+         if (html) {
+             fprintf(out, "<p>");
+             write_html_text(assignments, out);
+             fprintf(out, "</p>");
+         } else {
+             fprintf(out, ",\"expression2\":");
+             write_json_string(assignments, out);
+         }
+     }
+     if (format == RESPONSE_JSON) fputc(',', out);
+     if (emit_result(cache, stream, mode, format, &view, expr, assignments, out) != 0) {
+         /* A bitmap has no room for an error message; the status tells */
+         if (format == RESPONSE_BINARY) return -1;
+         write_error(format, "Out of memory.", out);
+     }
+ 
+     if (html) {
+         fprintf(out, "</body></html>");
+     } else if (format == RESPONSE_JSON) {
+         fprintf(out, "}\n");
+     }
+     return 0;
+ }
+ 
+ /* ============================ */
+ /* Persistent HTTP Server       */
+ /* ============================ */
+ 
+ /*
+  * With "--listen [HOST:]PORT" the program stays resident and answers HTTP
+  * requests itself instead of being spawned once per request by a CGI host.
+  * A single epoll loop multiplexes all connections; each GET request is run
+  * through handle_query, and HTTP/1.1 keep-alive and pipelining are honoured
+  * so clients can reuse connections. Large truth tables are sent with
+  * chunked transfer encoding while they are computed: whenever the socket
+  * can take more, the next chunk of rows is evaluated and queued, so the
+  * first rows leave at once and a slow client holds back the computation
+  * rather than a buffer of the whole table. Requests pipelined behind a
+  * streamed table wait until it is complete.
+  */
+ 
+ #define MAX_EVENTS 64
+ #define MAX_REQUEST_SIZE 65536
+ #define STREAM_BURST 4       /* table steps evaluated before other connections run */
+ 
+ typedef struct {
+     int fd;
+     char *in;            /* received bytes not yet handled */
+     size_t in_len;
+     char *out;           /* response bytes not yet sent */
+     size_t out_len;
+     size_t out_sent;
+     int close_after;     /* close once the pending output is sent */
+     TableStream *stream; /* the table being streamed, or NULL */
+ } Connection;
+ 
+ /**
+  * Switches a descriptor to non-blocking mode.
+  */
+ static int set_nonblocking(int fd) {
+     int flags = fcntl(fd, F_GETFL, 0);
+     return (flags < 0) ? -1 : fcntl(fd, F_SETFL, flags | O_NONBLOCK);
+ }
+ 
+ /**
+  * Closes a connection and releases its buffers.
+  */
+ static void close_connection(int epfd, Connection *c) {
+     epoll_ctl(epfd, EPOLL_CTL_DEL, c->fd, NULL);
+     close(c->fd);
+     if (c->stream) free_table_stream(c->stream);
+     free(c->in);
+     free(c->out);
+     free(c);
+ }
+ 
+ /**
+  * Appends bytes to the connection's output buffer.
+  */
+ static int queue_bytes(Connection *c, const char *data, size_t len) {
+     if (len == 0) return 0;
+     char *grown = realloc(c->out, c->out_len + len);
+     if (!grown) return -1;
+     c->out = grown;
+     memcpy(c->out + c->out_len, data, len);
+     c->out_len += len;
+     return 0;
+ }
+ 
+ /**
+  * Appends a complete HTTP response to the connection's output buffer.
+  */
+ static int queue_response(Connection *c, const char *status, const char *content_type,
+                           const char *body, size_t body_len) {
+     char header[256];
+     int header_len = snprintf(header, sizeof(header),
+                               "HTTP/1.1 %s\r\n"
+                               "Content-Type: %s\r\n"
+                               "Content-Length: %zu\r\n"
+                               "Connection: %s\r\n\r\n",
+                               status, content_type, body_len,
+                               c->close_after ? "close" : "keep-alive");
+     if (queue_bytes(c, header, header_len) != 0) return -1;
+     return queue_bytes(c, body, body_len);
+ }
+ 
+ /**
+  * Appends one chunk of a chunked response body; a zero-length chunk ends
+  * the body.
+  */
+ static int queue_chunk(Connection *c, const char *data, size_t len) {
+     char size[32];
+     int size_len = snprintf(size, sizeof(size), "%zx\r\n", len);
+     if (queue_bytes(c, size, size_len) != 0 || queue_bytes(c, data, len) != 0) return -1;
+     return queue_bytes(c, "\r\n", 2);
+ }
+ 
+ /**
+  * TableWriter sink that queues each buffer of rows as one chunk.
+  */
+ static size_t write_chunk(void *ctx, const char *data, size_t len) {
+     return queue_chunk(ctx, data, len) == 0 ? len : 0;
+ }
+ 
+ /**
+  * Starts a chunked response for a page whose truth table is streamed:
+  * queues the head and the page up to the table, and keeps the rest of the
+  * page for the end.
+  *
+  * @param c The connection.
+  * @param s The active stream, which the connection takes over.
+  * @param page The rendered page.
+  * @param page_len Its length.
+  * @return 0 on success, -1 if memory ran out.
+  */
+ static int start_stream(Connection *c, TableStream *s, const char *page, size_t page_len) {
+     c->stream = s;
+     s->tail_len = page_len - (size_t)s->page_at;
+     s->tail = malloc(s->tail_len);
+     if (!s->tail) return -1;
+     memcpy(s->tail, page + s->page_at, s->tail_len);
+     s->writer.sink = write_chunk;
+     s->writer.sink_ctx = c;
+     METRICS_ADD(streams, 1);
+ 
+     char header[256];
+     int header_len = snprintf(header, sizeof(header),
+                               "HTTP/1.1 200 OK\r\n"
+                               "Content-Type: text/html\r\n"
+                               "Transfer-Encoding: chunked\r\n"
+                               "Connection: %s\r\n\r\n",
+                               c->close_after ? "close" : "keep-alive");
+     if (queue_bytes(c, header, header_len) != 0) return -1;
+     return queue_chunk(c, page, (size_t)s->page_at);
+ }
+ 
+ /**
+  * Evaluates the next step of rows of the connection's streamed table on
+  * its threads and queues them. Steps after the first start on a chunk
+  * boundary. After the last one, queues the rest of the page and the end of
+  * the body and releases the stream.
+  *
+  * @return 0 on success, -1 if memory or threads ran out.
+  */
+ static int stream_next_chunk(Connection *c) {
+     TableStream *s = c->stream;
+     METRICS_START(start);
+     if (s->next_row < s->end_row) {
+         uint64_t step = (uint64_t)s->threads * STREAM_CHUNKS_PER_THREAD * CHUNK_ROWS
+                         - s->next_row % CHUNK_ROWS;
+         uint64_t count = s->end_row - s->next_row < step ? s->end_row - s->next_row : step;
+         int rc = parallel_truth_range(&s->prog, s->threads, s->next_row, count,
+                                       writer_rows, &s->writer);
+         s->next_row += count;
+         writer_flush(&s->writer);
+         METRICS_STAGE(STAGE_RENDER, start);
+         METRICS_ADD(rows_evaluated, count);
+         return rc != 0 || s->writer.error ? -1 : 0;
+     }
+     int rc = writer_finish(&s->writer);
+     if (rc == 0) rc = queue_chunk(c, s->tail, s->tail_len);
+     if (rc == 0) rc = queue_chunk(c, NULL, 0);
+     free_table_stream(s);
+     c->stream = NULL;
+     return rc;
+ }
+ 
+ /**
+  * Returns non-zero if the header block contains the given Connection token.
+  */
+ static int has_connection_token(const char *headers, const char *token) {
+     const char *p = headers;
+     while ((p = strchr(p, '\n')) != NULL) {
+         p++;
+         if (strncasecmp(p, "Connection:", 11) == 0) {
+             const char *end = strchr(p, '\n');
+             size_t len = end ? (size_t)(end - p) : strlen(p);
+             size_t token_len = strlen(token);
+             for (size_t i = 11; i + token_len <= len; i++) {
+                 if (strncasecmp(p + i, token, token_len) == 0) return 1;
+             }
+         }
+     }
+     return 0;
+ }
+ 
+ #ifdef SERVER_METRICS
+ static void write_metric(FILE *out, const char *name, const char *type, const char *help,
+                          unsigned long long value) {
+     fprintf(out, "# HELP %s %s\n# TYPE %s %s\n%s %llu\n", name, help, name, type, name, value);
+ }
+ 
+ /**
+  * Writes every metric in the Prometheus text exposition format.
+  */
+ static void write_metrics(FILE *out, const ResponseCache *cache) {
+     write_metric(out, "boolsolve_requests_total", "counter", "Requests answered.",
+                  g_metrics.requests);
+     write_metric(out, "boolsolve_rows_evaluated_total", "counter",
+                  "Truth-table rows evaluated.", g_metrics.rows_evaluated);
+     write_metric(out, "boolsolve_bytes_sent_total", "counter", "Response bytes sent.",
+                  g_metrics.bytes_sent);
+     write_metric(out, "boolsolve_streams_total", "counter",
+                  "Truth tables sent while being computed.", g_metrics.streams);
+     write_metric(out, "boolsolve_cache_hits_total", "counter", "Result cache hits.",
+                  cache->hits);
+     write_metric(out, "boolsolve_cache_misses_total", "counter", "Result cache misses.",
+                  cache->misses);
+     write_metric(out, "boolsolve_cache_evictions_total", "counter",
+                  "Result cache evictions.", cache->evictions);
+     write_metric(out, "boolsolve_cache_entries", "gauge", "Results in the cache.",
+                  cache->entries);
+     write_metric(out, "boolsolve_cache_bytes", "gauge", "Bytes held by the cache.",
+                  cache->bytes);
+ 
+     fprintf(out, "# HELP boolsolve_stage_seconds_total Time spent in each stage of requests.\n"
+                  "# TYPE boolsolve_stage_seconds_total counter\n");
+     for (int i = 0; i < STAGE_COUNT; i++) {
+         fprintf(out, "boolsolve_stage_seconds_total{stage=\"%s\"} %.9f\n", stage_names[i],
+                 g_metrics.stage_ns[i] * 1e-9);
+     }
+     fprintf(out, "# HELP boolsolve_stage_calls_total Times each stage ran.\n"
+                  "# TYPE boolsolve_stage_calls_total counter\n");
+     for (int i = 0; i < STAGE_COUNT; i++) {
+         fprintf(out, "boolsolve_stage_calls_total{stage=\"%s\"} %llu\n", stage_names[i],
+                 (unsigned long long)g_metrics.stage_calls[i]);
+     }
+ 
+     /* Buckets are cumulative; a streamed table counts until its head is queued */
+     fprintf(out, "# HELP boolsolve_request_duration_seconds Time to answer a request.\n"
+                  "# TYPE boolsolve_request_duration_seconds histogram\n");
+     unsigned long long below = 0;
+     for (size_t i = 0; i < LATENCY_BUCKETS; i++) {
+         below += g_metrics.latency[i];
+         fprintf(out, "boolsolve_request_duration_seconds_bucket{le=\"%g\"} %llu\n",
+                 latency_bounds[i], below);
+     }
+     fprintf(out, "boolsolve_request_duration_seconds_bucket{le=\"+Inf\"} %llu\n"
+                  "boolsolve_request_duration_seconds_sum %.9f\n"
+                  "boolsolve_request_duration_seconds_count %llu\n",
+             (unsigned long long)g_metrics.requests, g_metrics.latency_ns * 1e-9,
+             (unsigned long long)g_metrics.requests);
+ }
+ #endif
+ 
+ /**
+  * Handles one complete request held at the start of c->in.
+  *
+  * @param c The connection.
+  * @param request_len The length of the request head, including the blank line.
+  * @param cache The server's result cache.
+  * @return 0 on success, -1 if the connection must be dropped.
+  */
+ static int serve_request(Connection *c, size_t request_len, ResponseCache *cache) {
+     char *head = c->in;
+     head[request_len - 1] = '\0';
+ 
+     char method[16], target[MAX_REQUEST_SIZE], version[16];
+     if (sscanf(head, "%15s %65535s %15s", method, target, version) != 3) {
+         c->close_after = 1;
+         const char *body = "<h2>Error: Malformed request.</h2>";
+         return queue_response(c, "400 Bad Request", "text/html", body, strlen(body));
+     }
+ 
+     if (strcmp(version, "HTTP/1.0") == 0) {
+         c->close_after = !has_connection_token(head, "keep-alive");
+     } else {
+         c->close_after = has_connection_token(head, "close");
+     }
+ 
+     if (strcmp(method, "GET") != 0) {
+         c->close_after = 1;
+         const char *body = "<h2>Error: Only GET is supported.</h2>";
+         return queue_response(c, "405 Method Not Allowed", "text/html", body, strlen(body));
+     }
+ 
+     char *query = strchr(target, '?');
+     if (query) *query++ = '\0';
  
-     if (mode_param != NULL && strcmp(mode_param, "tt") == 0) {
-         printf("<h2>Truth Table for Expression:</h2>");
-         printf("<p>%s</p>", decoded_expr);
-         generate_truth_table(decoded_expr);
-         free(mode_param);
+     char *page = NULL;
+     size_t page_len = 0;
+     FILE *out = open_memstream(&page, &page_len);
+     if (!out) return -1;
+     const char *status = "200 OK";
+     const char *content_type = "text/html";
+     TableStream *stream = NULL;
+     if (strcmp(target, "/stats") == 0) {
+         /* Cache counters, one "name value" pair per line */
+         content_type = "text/plain";
+         fprintf(out, "cache_hits %llu\ncache_misses %llu\ncache_evictions %llu\n"
+                      "cache_entries %zu\ncache_bytes %zu\ncache_max_bytes %zu\n",
+                 (unsigned long long)cache->hits, (unsigned long long)cache->misses,
+                 (unsigned long long)cache->evictions, cache->entries, cache->bytes,
+                 cache->max_bytes);
+ #ifdef SERVER_METRICS
+     } else if (strcmp(target, "/metrics") == 0) {
+         content_type = "text/plain; version=0.0.4";
+         write_metrics(out, cache);
+ #endif
+     } else {
+         QueryParams params;
+         if (parse_query(&params, query) != 0) {
+             fclose(out);
+             free(page);
+             return -1;
+         }
+         content_type = response_content_type(response_format(&params));
+         /* Chunked transfer encoding needs HTTP/1.1; without memory for a
+          * stream the table is simply rendered */
+         if (strcmp(version, "HTTP/1.0") != 0) stream = calloc(1, sizeof(TableStream));
+         if (handle_query(&params, out, cache, stream) < 0) status = "500 Internal Server Error";
+         free_query(&params);
+     }
+     fclose(out);
+     int rc;
+     if (stream && stream->active) {
+         rc = start_stream(c, stream, page, page_len);
      } else {
-         printf("<h2>Evaluation Result for Expression:</h2>");
-         printf("<p>%s</p>", decoded_expr);
-         int result = evaluate_boolean_expression(decoded_expr);
-         printf("<p>Result: %d</p>", result);
+         if (stream) free_table_stream(stream);
+         rc = queue_response(c, status, content_type, page, page_len);
      }
+     free(page);
+     return rc;
+ }
  
-     free(decoded_expr);
-     printf("</body></html>");
+ /**
+  * Answers every pipelined request that has fully arrived, stopping after
+  * one whose table is streamed.
+  *
+  * @return 0 on success, -1 if the connection must be dropped.
+  */
+ static int serve_pending(Connection *c, ResponseCache *cache) {
+     while (!c->close_after && !c->stream) {
+         char *end = memmem(c->in, c->in_len, "\r\n\r\n", 4);
+         if (!end) break;
+         size_t request_len = (size_t)(end - c->in) + 4;
+         METRICS_START(start);
+         if (serve_request(c, request_len, cache) != 0) return -1;
+         METRICS_REQUEST(start);
+         memmove(c->in, c->in + request_len, c->in_len - request_len);
+         c->in_len -= request_len;
+     }
      return 0;
  }
- 
\ No newline at end of file
+ 
+ /**
+  * Reads from a readable connection and answers every complete request.
+  *
+  * @return 0 to keep the connection, -1 to close it.
+  */
+ static int on_readable(Connection *c, ResponseCache *cache) {
+     while (c->in_len < MAX_REQUEST_SIZE) {
+         ssize_t n = read(c->fd, c->in + c->in_len, MAX_REQUEST_SIZE - c->in_len);
+         if (n > 0) {
+             c->in_len += n;
+             continue;
+         }
+         if (n == 0) return (c->out_len > c->out_sent || c->stream) ? 0 : -1;
+         if (errno == EAGAIN || errno == EWOULDBLOCK) break;
+         if (errno == EINTR) continue;
+         return -1;
+     }
+ 
+     if (serve_pending(c, cache) != 0) return -1;
+     /* A full buffer without a complete request head cannot make progress */
+     return (c->in_len == MAX_REQUEST_SIZE && !c->stream) ? -1 : 0;
+ }
+ 
+ /**
+  * Sends as much pending output as the socket accepts.
+  *
+  * @return 1 if output is still pending, 0 if it was all sent, -1 on error.
+  */
+ static int on_writable(Connection *c) {
+     while (c->out_sent < c->out_len) {
+         ssize_t n = write(c->fd, c->out + c->out_sent, c->out_len - c->out_sent);
+         if (n > 0) {
+             c->out_sent += n;
+             METRICS_ADD(bytes_sent, (uint64_t)n);
+         } else if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+             return 1;
+         } else if (n < 0 && errno == EINTR) {
+             continue;
+         } else {
+             return -1;
+         }
+     }
+     c->out_len = c->out_sent = 0;
+     return 0;
+ }
+ 
+ /**
+  * Sends pending output and, while a table is streaming, evaluates more of
+  * it each time the socket has taken everything. Once the stream ends, the
+  * requests pipelined behind it are answered.
+  *
+  * @return 1 if output is still pending, 0 if it was all sent, -1 on error.
+  */
+ static int pump_connection(Connection *c, ResponseCache *cache) {
+     for (int chunks = 0; ; chunks++) {
+         METRICS_START(start);
+         int rc = on_writable(c);
+         METRICS_STAGE(STAGE_WRITE, start);
+         if (rc != 0 || c->stream == NULL) return rc;
+         /* Let other connections run; the socket is writable, so EPOLLOUT
+          * brings us straight back */
+         if (chunks == STREAM_BURST) return 1;
+         if (stream_next_chunk(c) != 0) return -1;
+         if (c->stream == NULL && serve_pending(c, cache) != 0) return -1;
+     }
+ }
+ 
+ /**
+  * Runs the persistent server until the process is terminated.
+  *
+  * @param address "[HOST:]PORT" to listen on; HOST defaults to 127.0.0.1.
+  * @return 1 if the server could not be started.
+  */
+ int run_server(const char *address) {
+     char host[64] = "127.0.0.1";
+     const char *port = address;
+     const char *colon = strrchr(address, ':');
+     if (colon) {
+         size_t host_len = (size_t)(colon - address);
+         if (host_len >= sizeof(host)) host_len = sizeof(host) - 1;
+         memcpy(host, address, host_len);
+         host[host_len] = '\0';
+         port = colon + 1;
+     }
+ 
+     struct sockaddr_in addr;
+     memset(&addr, 0, sizeof(addr));
+     addr.sin_family = AF_INET;
+     long port_number;
+     if (parse_option_number(port, 0, 65535, &port_number) != 0
+         || inet_pton(AF_INET, host, &addr.sin_addr) != 1) {
+         fprintf(stderr, "Error: Invalid listen address '%s'.\n", address);
+         return 1;
+     }
+     addr.sin_port = htons((unsigned short)port_number);
+ 
+     int listen_fd = socket(AF_INET, SOCK_STREAM, 0);
+     int one = 1;
+     if (listen_fd < 0
+         || setsockopt(listen_fd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one)) != 0
+         || bind(listen_fd, (struct sockaddr *)&addr, sizeof(addr)) != 0
+         || listen(listen_fd, SOMAXCONN) != 0
+         || set_nonblocking(listen_fd) != 0) {
+         perror("listen");
+         return 1;
+     }
+ 
+     int epfd = epoll_create1(0);
+     struct epoll_event ev = { .events = EPOLLIN, .data.ptr = NULL };
+     if (epfd < 0 || epoll_ctl(epfd, EPOLL_CTL_ADD, listen_fd, &ev) != 0) {
+         perror("epoll");
+         return 1;
+     }
+     signal(SIGPIPE, SIG_IGN);
+     fprintf(stderr, "Listening on %s:%s\n", host, port);
+ 
+     ResponseCache cache;
+     cache_init(&cache, g_config.cache_bytes);
+ 
+     struct epoll_event events[MAX_EVENTS];
+     for (;;) {
+         int n = epoll_wait(epfd, events, MAX_EVENTS, -1);
+         if (n < 0) {
+             if (errno == EINTR) continue;
+             perror("epoll_wait");
+             return 1;
+         }
+         for (int i = 0; i < n; i++) {
+             Connection *c = events[i].data.ptr;
+             if (c == NULL) {
+                 /* Accept every pending connection */
+                 int fd;
+                 while ((fd = accept(listen_fd, NULL, NULL)) >= 0) {
+                     c = calloc(1, sizeof(Connection));
+                     if (c) c->in = malloc(MAX_REQUEST_SIZE);
+                     if (!c || !c->in || set_nonblocking(fd) != 0) {
+                         if (c) free(c->in);
+                         free(c);
+                         close(fd);
+                         continue;
+                     }
+                     c->fd = fd;
+                     struct epoll_event cev = { .events = EPOLLIN, .data.ptr = c };
+                     epoll_ctl(epfd, EPOLL_CTL_ADD, fd, &cev);
+                 }
+                 continue;
+             }
+ 
+             int rc = 0;
+             if (events[i].events & (EPOLLIN | EPOLLHUP | EPOLLERR)) {
+                 rc = on_readable(c, &cache);
+             }
+             if (rc == 0 && (c->out_len > c->out_sent || c->stream)) {
+                 rc = pump_connection(c, &cache);
+                 if (rc == 0 && c->close_after) rc = -1;
+             }
+             if (rc < 0) {
+                 close_connection(epfd, c);
+                 continue;
+             }
+             /* Wait for writability only while output is pending or a table
+              * is streaming */
+             struct epoll_event cev = { .events = rc == 1 ? EPOLLOUT : EPOLLIN, .data.ptr = c };
+             epoll_ctl(epfd, EPOLL_CTL_MOD, c->fd, &cev);
+         }
+     }
+ }
+ 
+ /* ============================ */
+ /* Main CGI Function          */
+ /* ============================ */
+ 
+ /**
+  * Prints the command-line options.
+  */
+ static void print_usage(const char *progname) {
+     fprintf(stderr, "Usage: %s [--listen [HOST:]PORT] [--threads N] [--cache-mb N]\n"
+                     "Without --listen, answers the CGI request in QUERY_STRING.\n", progname);
+ }
+
+ int main(int argc, char *argv[]) {
+     const char *listen_address = NULL;
+     long number;
+     const char *threads_env = getenv("SOLVER_THREADS");
+     if (threads_env) {
+         if (parse_option_number(threads_env, 1, INT_MAX, &number) != 0) {
+             fprintf(stderr, "Error: Invalid SOLVER_THREADS '%s'.\n", threads_env);
+             return 1;
+         }
+         g_config.threads = (int)number;
+     }
+     for (int i = 1; i < argc; i++) {
+         if (strcmp(argv[i], "--listen") == 0 && i + 1 < argc) {
+             listen_address = argv[++i];
+         } else if (strcmp(argv[i], "--threads") == 0 && i + 1 < argc
+                    && parse_option_number(argv[i + 1], 1, INT_MAX, &number) == 0) {
+             g_config.threads = (int)number;
+             i++;
+         } else if (strcmp(argv[i], "--cache-mb") == 0 && i + 1 < argc
+                    && parse_option_number(argv[i + 1], 0, (long)(SIZE_MAX >> 21), &number) == 0) {
+             g_config.cache_bytes = (size_t)number << 20;
+             i++;
+         } else {
+             print_usage(argv[0]);
+             return 1;
+         }
+     }
+     if (listen_address) {
+         return run_server(listen_address);
+     }
+ 
+     /* Retrieve and parse the QUERY_STRING from the environment */
+     QueryParams params;
+     if (parse_query(&params, getenv("QUERY_STRING")) != 0) {
+         printf("Content-Type: text/html\n\n<h2>Error: Out of memory.</h2>");
+         return 1;
+     }
+ 
+     /* Output the HTTP header. A bitmap is held back until it is complete,
+      * so that running out of memory can still be told in the status. */
+     int format = response_format(&params);
+     if (format != RESPONSE_BINARY) {
+         printf("Content-Type: %s\n\n", response_content_type(format));
+         int rc = handle_query(&params, stdout, NULL, NULL);
+         free_query(&params);
+         return rc;
+     }
+     char *body = NULL;
+     size_t body_len = 0;
+     FILE *mem = open_memstream(&body, &body_len);
+     int rc = mem ? handle_query(&params, mem, NULL, NULL) : -1;
+     if (mem && fclose(mem) != 0) rc = -1;
+     free_query(&params);
+     if (rc < 0) {
+         printf("Status: 500 Internal Server Error\n");
+         body_len = 0;
+     }
+     printf("Content-Type: %s\n\n", response_content_type(format));
+     fwrite(body, 1, body_len, stdout);
+     free(body);
+     return rc < 0 ? 1 : rc;
+ }
@@ -1,249 +1,709 @@
 /*
  * solver.c - Boolean Expression Solver in C
  *
- * This file implements a recursive descent parser for Boolean expressions,
- * along with functions to evaluate expressions and generate truth tables.
+ * This file is the command-line front end: it reads Boolean expressions and
+ * evaluates them or prints their truth tables with the parser and engines of
+ * the libboolsolve core library (boolsolve.h).
  *
  * Supported Boolean Operators:
  *   '+'  => Logical OR
- *   '·'  => Logical AND
+ *   '·'  => Logical AND ('&' and '*' are accepted as well)
  *   '!'  => Logical NOT
  *
  * Parentheses '(' and ')' are supported for grouping.
  *
  * Literals: '0' and '1'
- * Variables: Any alphabetic character (A, B, C, etc.). By default, each variable is assumed to be true (1).
+ * Variables: Any alphabetic character (A, B, C, etc.). Unless assigned with --assign, each variable is assumed to be true (1).
  *
  * Compilation:
- *   gcc -o solver solver.c
+ *   make solver     (links against libboolsolve.a, see boolsolve.h)
  *
  * Usage:
- *   ./solver
+ *   ./solver [--assign A=0,B=1]
  *     - Prompts for a Boolean expression, evaluates it, and displays the result.
+ *       Variables not listed in --assign are true (1).
  *
- *   ./solver --truth-table
- *     - Prompts for a Boolean expression, then generates and prints its truth table.
+ *   ./solver --batch [FILE]
+ *     - Evaluates one expression per line of FILE (memory-mapped) or stdin,
+ *       each optionally followed by "; A=0,B=1" variable assignments, and
+ *       prints one result per line.
+ *
+ *   ./solver --truth-table [--threads N] [--format text|csv|html|bin]
+ *            [--only-true | --only-false] [--gray | --gray-order]
+ *     - Prompts for a Boolean expression, then generates and prints its truth table,
+ *       evaluating it on N threads (default 1). Formats other than text print
+ *       only the table; "bin" is a packed bitmap of the results. With
+ *       --only-true or --only-false, the text formats print only the rows
+ *       with that result. --gray evaluates the table on one thread in
+ *       Gray-code order, recomputing only what depends on the variable that
+ *       flips, which suits wide expressions; --gray-order also prints the
+ *       rows of the text formats in that order.
+ *
+ *   ./solver --columns FILE [--threads N]
+ *     - Prompts for a Boolean expression and evaluates it for every row of
+ *       a column file (one packed bit column per variable, see boolsolve.h)
+ *       on N threads, writing the packed result column to stdout.
+ *
+ *   ./solver --multi [--truth-table ... | --columns FILE ...]
+ *     - Reads up to 64 expressions, one per line until an empty line or the
+ *       end of the input, compiles them into one program that computes
+ *       their common subterms once, and evaluates all of them in a single
+ *       sweep: a truth table (the default) with one result column per
+ *       expression, where --only-true and --only-false keep the rows on
+ *       which any of them has that result, or the rows of a column file, written as one
+ *       little-endian word of 64 results per expression in turn, for every
+ *       64 rows.
+ *
+ *   ./solver --simplify [--threads N]
+ *     - Prompts for a Boolean expression and prints a minimal sum of products
+ *       and a minimal product of sums for it (at most 20 variables).
+ *
+ *   ./solver --sat | --count
+ *     - Prompts for a Boolean expression and, without enumerating its truth
+ *       table, reports a satisfying assignment or the number of satisfying
+ *       assignments.
+ *
+ *   ./solver --equiv EXPR2 | --tautology [--threads N]
+ *     - Prompts for a Boolean expression and reports whether it is
+ *       equivalent to EXPR2, or always true, with an assignment on which
+ *       that fails if it does not hold. Up to 24 variables, its truth table
+ *       is swept on N threads up to the first such assignment; wider
+ *       expressions are compared with a BDD, which also counts them.
  */
 
+ #include "boolsolve.h"
+
  #include <stdio.h>
  #include <stdlib.h>
  #include <string.h>
- #include <ctype.h>
+ #include <errno.h>
+ #include <limits.h>
+ #include <time.h>
+ #include <fcntl.h>
+ #include <unistd.h>
+ #include <sys/mman.h>
+ #include <sys/stat.h>
  
+ /* What main does with the expression it reads */
+ enum { MODE_EVALUATE, MODE_TRUTH_TABLE, MODE_SIMPLIFY, MODE_SAT, MODE_COUNT, MODE_EQUIV,
+        MODE_TAUTOLOGY, MODE_COLUMNS };
+
+ /* How generate_truth_table evaluates the table and orders its rows */
+ enum { ORDER_ROWS, ORDER_GRAY_EVALUATION, ORDER_GRAY };
+
  /* -------------------------------------------------------------------------
-  * Global Variable Mapping:
-  * Each index in this array corresponds to an ASCII character.
-  * For any alphabetic variable (e.g., 'A'), g_var_mapping[(int)'A'] holds its Boolean value.
-  * By default, every variable is set to true (1) unless overridden.
+  * Function Prototypes
   * ------------------------------------------------------------------------- */
- static int g_var_mapping[256] = {0};
+ void generate_truth_table(const char *const *exprs, int count, int threads, int format,
+                           int filter, int order);
+ int simplify_expression(const char *expr, int threads);
+ int run_query(int mode, const char *expr, const char *expr2, int threads);
+ int run_batch(const char *path);
+ int run_columns(const char *path, const char *const *exprs, int count, int threads);
+ int parse_threads(const char *text, int *threads);
+ void print_usage(const char *progname);
  
  /* -------------------------------------------------------------------------
-  * Function Prototypes
+  * generate_truth_table:
+  *   Generates and prints a truth table for the provided Boolean expressions.
+  *   They are compiled and optimized once, together; the program is then run
+  *   for every possible combination of truth values of their variables, and
+  *   the results are printed, one column per expression.
+  *
+  *   Parameters:
+  *     exprs   - The Boolean expressions.
+  *     count   - Their number; Gray-code order takes only one.
+  *     threads - Number of threads evaluating the table.
+  *     format  - Output format, one of the FORMAT_ values.
+  *     filter  - Rows to print, one of the FILTER_ values.
+  *     order   - ORDER_ROWS for the parallel engine, ORDER_GRAY_EVALUATION
+  *               to evaluate in Gray-code order but print rows in order, or
+  *               ORDER_GRAY to print them in Gray-code order as well (the
+  *               binary format is always in row order).
   * ------------------------------------------------------------------------- */
- static void skip_whitespace(const char **s);
- static int parse_expression(const char **s);
- static int parse_term(const char **s);
- static int parse_factor(const char **s);
- int evaluate_boolean_expression(const char *expr);
- int evaluate_expr_with_mapping(const char *expr, int mapping[256]);
- void generate_truth_table(const char *expr);
- void print_usage(const char *progname);
+ void generate_truth_table(const char *const *exprs, int count, int threads, int format,
+                           int filter, int order) {
+     Program prog;
+     if (compile_expressions(exprs, count, &prog) != 0) {
+         fprintf(stderr, "Error: Out of memory.\n");
+         return;
+     }
+     // Simplify once up front; every row then runs the shorter program.
+     // If the optimizer runs out of memory the program is left as it was.
+     optimize_program(&prog);
+ 
+     if (format == FORMAT_TEXT) {
+         printf("\nTruth Table:\n");
+         if (count > 1) {
+             for (int i = 0; i < count; i++) {
+                 printf("Result %d: %s\n", i + 1, exprs[i]);
+             }
+         }
+     }
+     TableWriter writer;
+     if (writer_init(&writer, format, &prog, STDOUT_FILENO, NULL) != 0) {
+         fprintf(stderr, "Error: Out of memory.\n");
+         free_program(&prog);
+         return;
+     }
+     writer.filter = filter;
+     writer.gray_order = order == ORDER_GRAY && format != FORMAT_BINARY;
+     // Stream the table chunk by chunk; the row index is the assignment.
+     int rc = order == ORDER_ROWS
+              ? parallel_truth_table(&prog, threads, writer_rows, &writer)
+              : gray_truth_table(&prog, writer.gray_order, writer_rows, &writer);
+     if (rc != 0) {
+         fprintf(stderr, "Error: Out of memory.\n");
+     }
+     if (writer_finish(&writer) != 0) {
+         fprintf(stderr, "Error: Failed to write the truth table.\n");
+     }
+     free_program(&prog);
+ }
  
  /* -------------------------------------------------------------------------
-  * skip_whitespace:
-  *   Advances the pointer past any whitespace characters.
+  * simplify_expression:
+  *   Prints a minimal sum of products and a minimal product of sums for the
+  *   provided Boolean expression, both derived from its truth table.
+  *
+  *   Parameters:
+  *     expr    - The Boolean expression.
+  *     threads - Number of threads evaluating the table.
+  *
+  *   Returns:
+  *     0 on success, 1 if there are too many variables or memory ran out.
   * ------------------------------------------------------------------------- */
- static void skip_whitespace(const char **s) {
-     while (**s && isspace(**s)) {
-         (*s)++;
+ int simplify_expression(const char *expr, int threads) {
+     Program prog;
+     if (compile_expression(expr, &prog) != 0) {
+         fprintf(stderr, "Error: Out of memory.\n");
+         return 1;
+     }
+     if (prog.var_count > MINIMIZE_MAX_VARS) {
+         fprintf(stderr, "Error: Simplification supports at most %d variables.\n",
+                 MINIMIZE_MAX_VARS);
+         free_program(&prog);
+         return 1;
+     }
+     optimize_program(&prog);
+
+     Cover sop, pos;
+     int rc = minimize_program(&prog, threads, &sop, &pos);
+     free_program(&prog);
+     if (rc != 0) {
+         fprintf(stderr, "Error: Out of memory.\n");
+         return 1;
      }
+     printf("\nSum of products: ");
+     write_cover(&sop, 0, stdout);
+     printf("\nProduct of sums: ");
+     write_cover(&pos, 1, stdout);
+     printf("\n");
+     free_cover(&sop);
+     free_cover(&pos);
+     return 0;
  }
+
+ /* -------------------------------------------------------------------------
+  * Batch Mode:
+  * Evaluates one expression per input line, optionally followed by ';' and
+  * an assignment list ("A + B ; A=0,B=1"). Variables that are not assigned
+  * are true, as in the default evaluation. One program, evaluator and line
+  * buffer are reused for the whole run, and results ("0", "1" or "error")
+  * go through a large stdout buffer, one line per input line.
+  * Consecutive lines with the same expression share its compiled program,
+  * and their assignments are evaluated 64 at a time by a Kernel, which turns
+  * into machine code once the expression has repeated often enough.
+  * ------------------------------------------------------------------------- */
+ #define BATCH_OUTPUT_BUFFER (1 << 20)
+ #define BATCH_GROUP 64
+ 
+ typedef struct {
+     Program prog;
+     Evaluator ev;
+     Kernel kernel;
+     int kernel_ready;         /* kernel is bound to prog */
+     char *line;               /* NUL-terminated copy of the current line */
+     size_t line_capacity;
+     char *expr;               /* the expression prog was compiled from */
+     size_t expr_capacity;
+     uint64_t values[BATCH_GROUP];       /* assignments of the pending lines */
+     unsigned char failed[BATCH_GROUP];  /* pending lines with a bad assignment list */
+     int pending;
+     unsigned long long count; /* lines evaluated so far */
+ } Batch;
  
  /* -------------------------------------------------------------------------
-  * parse_expression:
-  *   Parses an expression which may include one or more terms separated by '+'
-  *   (logical OR). Grammar: expression = term { '+' term }
+  * transpose_bits:
+  *   Transposes a 64x64 bit matrix in place, so that bit c of word r moves
+  *   to bit r of word c, by swapping ever smaller blocks.
   * ------------------------------------------------------------------------- */
- static int parse_expression(const char **s) {
-     int value = parse_term(s);
-     skip_whitespace(s);
-     while (**s == '+') { // '+' denotes OR
-         (*s)++;  // Consume '+'
-         skip_whitespace(s);
-         int term_value = parse_term(s);
-         value = (value || term_value) ? 1 : 0;
-         skip_whitespace(s);
-     }
-     return value;
+ static void transpose_bits(uint64_t m[64]) {
+     uint64_t mask = 0x00000000FFFFFFFFULL;
+     for (int j = 32; j != 0; j >>= 1, mask ^= mask << j) {
+         for (int k = 0; k < 64; k = ((k | j) + 1) & ~j) {
+             uint64_t t = ((m[k] >> j) ^ m[k | j]) & mask;
+             m[k] ^= t << j;
+             m[k | j] ^= t;
+         }
+     }
  }
  
  /* -------------------------------------------------------------------------
-  * parse_term:
-  *   Parses a term which may include one or more factors separated by '·'
-  *   (logical AND). Grammar: term = factor { '·' factor }
+  * batch_flush:
+  *   Evaluates and prints the pending lines. A full group goes through the
+  *   kernel as bitslices, anything less through the evaluator.
+  *
+  *   Returns:
+  *     0 on success, -1 if memory could not be allocated.
   * ------------------------------------------------------------------------- */
- static int parse_term(const char **s) {
-     int value = parse_factor(s);
-     skip_whitespace(s);
-     while (**s == '·') { // '·' denotes AND
-         (*s)++;  // Consume '·'
-         skip_whitespace(s);
-         int factor_value = parse_factor(s);
-         value = (value && factor_value) ? 1 : 0;
-         skip_whitespace(s);
-     }
-     return value;
+ static int batch_flush(Batch *b) {
+     uint64_t results = 0;
+     if (b->pending == BATCH_GROUP) {
+         if (!b->kernel_ready) {
+             if (kernel_init(&b->kernel, &b->prog) != 0) {
+                 return -1;
+             }
+             b->kernel_ready = 1;
+         }
+         uint64_t slices[BATCH_GROUP];
+         memcpy(slices, b->values, sizeof(slices));
+         transpose_bits(slices);
+         results = kernel_run(&b->kernel, slices);
+     } else {
+         for (int k = 0; k < b->pending; k++) {
+             b->ev.values = b->values[k];
+             results |= (uint64_t)evaluator_run(&b->ev) << k;
+         }
+     }
+     for (int k = 0; k < b->pending; k++) {
+         if (b->failed[k]) {
+             fputs("error\n", stdout);
+         } else {
+             putchar_unlocked('0' + (int)((results >> k) & 1));
+             putchar_unlocked('\n');
+         }
+     }
+     b->pending = 0;
+     return 0;
  }
  
  /* -------------------------------------------------------------------------
-  * parse_factor:
-  *   Parses a factor, which may be:
-  *     - A NOT operation: '!' factor
-  *     - A grouped expression: '(' expression ')'
-  *     - A literal ('0' or '1') or variable (alphabetic character)
-  *   Grammar: factor = '!' factor | '(' expression ')' | literal
+  * batch_line:
+  *   Evaluates one batch line of 'len' bytes and prints its result.
+  *
+  *   Returns:
+  *     0 on success, -1 if memory could not be allocated.
   * ------------------------------------------------------------------------- */
- static int parse_factor(const char **s) {
-     skip_whitespace(s);
-     int value = 0;
+ static int batch_line(Batch *b, const char *text, size_t len) {
+     if (len > 0 && text[len - 1] == '\r') {
+         len--;
+     }
+     if (len + 1 > b->line_capacity) {
+         char *line = realloc(b->line, len + 1);
+         if (!line) {
+             return -1;
+         }
+         b->line = line;
+         b->line_capacity = len + 1;
+     }
+     memcpy(b->line, text, len);
+     b->line[len] = '\0';
  
-     if (**s == '!') {
-         // Handle NOT: !factor
-         (*s)++;  // Consume '!'
-         int factor_value = parse_factor(s);
-         value = (!factor_value) ? 1 : 0;
-     } else if (**s == '(') {
-         // Handle grouping: ( expression )
-         (*s)++;  // Consume '('
-         value = parse_expression(s);
-         skip_whitespace(s);
-         if (**s == ')') {
-             (*s)++;  // Consume ')'
-         } else {
-             fprintf(stderr, "Error: Missing closing parenthesis.\n");
-         }
-     } else if (isdigit(**s)) {
-         // Literal: 0 or 1
-         value = **s - '0';
-         (*s)++;
-     } else if (isalpha(**s)) {
-         // Variable: Look up its value in g_var_mapping.
-         char var = **s;
-         (*s)++;
-         value = g_var_mapping[(int)var];
+     char *assignments = strchr(b->line, ';');
+     if (assignments) {
+         *assignments++ = '\0';
+     }
+     size_t expr_len = strlen(b->line);
+     if (!b->expr || strcmp(b->line, b->expr) != 0) {
+         // A new expression: finish the lines of the previous one first.
+         if (batch_flush(b) != 0) {
+             return -1;
+         }
+         if (b->kernel_ready) {
+             kernel_free(&b->kernel);
+             b->kernel_ready = 0;
+         }
+         if (expr_len + 1 > b->expr_capacity) {
+             char *expr = realloc(b->expr, expr_len + 1);
+             if (!expr) {
+                 return -1;
+             }
+             b->expr = expr;
+             b->expr_capacity = expr_len + 1;
+         }
+         memcpy(b->expr, b->line, expr_len + 1);
+         if (recompile_expression(b->line, &b->prog) != 0
+             || evaluator_bind(&b->ev, &b->prog) != 0) {
+             return -1;
+         }
+     }
+     b->ev.values = ~0ULL;
+     b->failed[b->pending] = assignments && apply_assignments(&b->ev, assignments) != 0;
+     b->values[b->pending++] = b->ev.values;
+     b->count++;
+     return b->pending == BATCH_GROUP ? batch_flush(b) : 0;
+ }
+ 
+ /* -------------------------------------------------------------------------
+  * run_batch:
+  *   Runs batch mode over a file, which is memory-mapped, or over stdin
+  *   when 'path' is NULL. The throughput is reported on stderr.
+  *
+  *   Returns:
+  *     0 on success, 1 on failure.
+  * ------------------------------------------------------------------------- */
+ int run_batch(const char *path) {
+     static char output[BATCH_OUTPUT_BUFFER];
+     setvbuf(stdout, output, _IOFBF, sizeof(output));
+ 
+     Batch b;
+     memset(&b, 0, sizeof(b));
+     if (compile_expression("", &b.prog) != 0 || evaluator_init(&b.ev, &b.prog) != 0) {
+         fprintf(stderr, "Error: Out of memory.\n");
+         return 1;
+     }
+     struct timespec start, end;
+     clock_gettime(CLOCK_MONOTONIC, &start);
+ 
+     int rc = 0;
+     if (path) {
+         int fd = open(path, O_RDONLY);
+         struct stat st;
+         if (fd < 0 || fstat(fd, &st) != 0) {
+             perror(path);
+             rc = 1;
+         } else if (st.st_size > 0) {
+             const char *data = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+             if (data == MAP_FAILED) {
+                 perror(path);
+                 rc = 1;
+             } else {
+                 madvise((void *)data, st.st_size, MADV_SEQUENTIAL);
+                 const char *p = data, *stop = data + st.st_size;
+                 while (p < stop && rc == 0) {
+                     const char *nl = memchr(p, '\n', stop - p);
+                     size_t len = nl ? (size_t)(nl - p) : (size_t)(stop - p);
+                     rc = batch_line(&b, p, len);
+                     p += len + 1;
+                 }
+                 munmap((void *)data, st.st_size);
+             }
+         }
+         if (fd >= 0) {
+             close(fd);
+         }
      } else {
-         // Skip unrecognized characters (could add error handling here).
-         (*s)++;
+         char *line = NULL;
+         size_t capacity = 0;
+         ssize_t len;
+         while (rc == 0 && (len = getline(&line, &capacity, stdin)) >= 0) {
+             if (len > 0 && line[len - 1] == '\n') {
+                 len--;
+             }
+             rc = batch_line(&b, line, (size_t)len);
+         }
+         free(line);
      }
+     if (rc == 0) {
+         rc = batch_flush(&b);
+     }
+     if (rc < 0) {
+         fprintf(stderr, "Error: Out of memory.\n");
+         rc = 1;
+     }
+     fflush(stdout);
+ 
+     clock_gettime(CLOCK_MONOTONIC, &end);
+     double seconds = (end.tv_sec - start.tv_sec) + (end.tv_nsec - start.tv_nsec) / 1e9;
+     fprintf(stderr, "%llu expressions in %.3f s (%.0f expressions/s)\n",
+             b.count, seconds, seconds > 0 ? b.count / seconds : 0.0);
  
-     return value;
+     if (b.kernel_ready) {
+         kernel_free(&b.kernel);
+     }
+     evaluator_free(&b.ev);
+     free_program(&b.prog);
+     free(b.line);
+     free(b.expr);
+     return rc;
  }
  
  /* -------------------------------------------------------------------------
-  * evaluate_boolean_expression:
-  *   Evaluates a Boolean expression using the default variable mapping,
-  *   which assumes all alphabetic variables are true (1).
+  * run_columns:
+  *   Evaluates expressions for every row of a column file and writes the
+  *   packed result column to stdout, a window of COLUMN_WINDOW words per
+  *   thread at a time. Several expressions are evaluated together, and for
+  *   every word of 64 rows their result words are written in turn. The
+  *   throughput is reported on stderr.
   *
   *   Parameters:
-  *     expr - The Boolean expression as a string.
+  *     path    - The column file.
+  *     exprs   - The Boolean expressions; every variable must be a column.
+  *     count   - Their number.
+  *     threads - Number of threads evaluating the rows.
   *
   *   Returns:
-  *     The evaluated result (0 or 1).
+  *     0 on success, 1 on failure.
   * ------------------------------------------------------------------------- */
- int evaluate_boolean_expression(const char *expr) {
-     // Set default mapping: every variable is assumed true.
-     for (int i = 0; i < 256; i++) {
-         g_var_mapping[i] = 1;
-     }
-     const char *p = expr;
-     int result = parse_expression(&p);
-     return result;
+ #define COLUMN_WINDOW (1 << 16)
+ 
+ int run_columns(const char *path, const char *const *exprs, int count, int threads) {
+     Program prog;
+     if (compile_expressions(exprs, count, &prog) != 0) {
+         fprintf(stderr, "Error: Out of memory.\n");
+         return 1;
+     }
+     optimize_program(&prog);
+     ColumnFile f;
+     int rc = column_open(&f, path);
+     if (rc != 0) {
+         if (rc == -1) {
+             perror(path);
+         } else {
+             fprintf(stderr, "Error: %s is not a column file.\n", path);
+         }
+         free_program(&prog);
+         return 1;
+     }
+     for (int j = 0; j < prog.var_count; j++) {
+         if (column_find(&f, prog.vars[j]) < 0) {
+             fprintf(stderr, "Error: Variable %c is not a column of %s.\n", prog.vars[j], path);
+             column_close(&f);
+             free_program(&prog);
+             return 1;
+         }
+     }
+ 
+     if (threads < 1) {
+         threads = 1;
+     }
+     uint64_t window = (uint64_t)COLUMN_WINDOW * (uint64_t)threads;
+     uint64_t *results = malloc(window * count * sizeof(uint64_t));
+     uint64_t *interleaved = count > 1 ? malloc(window * count * sizeof(uint64_t)) : results;
+     if (!results || !interleaved) {
+         free(results);
+         if (interleaved != results) {
+             free(interleaved);
+         }
+         fprintf(stderr, "Error: Out of memory.\n");
+         column_close(&f);
+         free_program(&prog);
+         return 1;
+     }
+     struct timespec start, end;
+     clock_gettime(CLOCK_MONOTONIC, &start);
+ 
+     // Only the bytes holding rows are written, as in a binary table;
+     // interleaved results are written in whole words.
+     uint64_t bytes_left = count > 1 ? f.words * 8 * count : f.rows / 8 + (f.rows % 8 != 0);
+     for (uint64_t w = 0; w < f.words && rc == 0; w += window) {
+         uint64_t words = f.words - w < window ? f.words - w : window;
+         if (evaluate_columns(&prog, &f, threads, w, words, results) != 0) {
+             fprintf(stderr, "Error: Out of memory.\n");
+             rc = 1;
+             break;
+         }
+         if (count > 1) {
+             for (uint64_t i = 0; i < words; i++) {
+                 for (int o = 0; o < count; o++) {
+                     interleaved[i * count + o] = results[o * words + i];
+                 }
+             }
+         }
+         size_t n = (size_t)(words * 8 * count < bytes_left ? words * 8 * count : bytes_left);
+         if (fwrite(interleaved, 1, n, stdout) != n) {
+             fprintf(stderr, "Error: Failed to write the results.\n");
+             rc = 1;
+         }
+         bytes_left -= n;
+     }
+     if (fflush(stdout) != 0 && rc == 0) {
+         fprintf(stderr, "Error: Failed to write the results.\n");
+         rc = 1;
+     }
+ 
+     clock_gettime(CLOCK_MONOTONIC, &end);
+     double seconds = (end.tv_sec - start.tv_sec) + (end.tv_nsec - start.tv_nsec) / 1e9;
+     if (rc == 0) {
+         fprintf(stderr, "%llu rows in %.3f s (%.0f rows/s)\n", (unsigned long long)f.rows,
+                 seconds, seconds > 0 ? f.rows / seconds : 0.0);
+     }
+     if (interleaved != results) {
+         free(interleaved);
+     }
+     free(results);
+     column_close(&f);
+     free_program(&prog);
+     return rc;
  }
  
  /* -------------------------------------------------------------------------
-  * evaluate_expr_with_mapping:
-  *   Evaluates a Boolean expression using a provided variable mapping.
+  * print_model:
+  *   Prints an assignment of a query's variables as "A=1, B=0".
+  * ------------------------------------------------------------------------- */
+ static void print_model(const BddResult *r) {
+     for (int j = 0; j < r->var_count; j++) {
+         printf("%s%c=%d", j ? ", " : "", r->vars[j],
+                (int)(r->model >> (r->var_count - j - 1)) & 1);
+     }
+ }
+
+ /* -------------------------------------------------------------------------
+  * run_query:
+  *   Answers a satisfiability or counting query about an expression with a
+  *   BDD, which needs no truth table and so handles far more variables than
+  *   enumeration could, or an equivalence or tautology query with
+  *   check_equivalence, which stops at the first counterexample.
   *
   *   Parameters:
+  *     mode    - MODE_SAT, MODE_COUNT, MODE_EQUIV or MODE_TAUTOLOGY.
   *     expr    - The Boolean expression as a string.
-  *     mapping - An array of 256 ints mapping each character to its Boolean value.
+  *     expr2   - The expression to compare it with for MODE_EQUIV.
+  *     threads - Number of threads sweeping the truth table.
   *
   *   Returns:
-  *     The evaluated result (0 or 1).
+  *     0 on success, 1 if the BDD grew too large or memory ran out.
   * ------------------------------------------------------------------------- */
- int evaluate_expr_with_mapping(const char *expr, int mapping[256]) {
-     memcpy(g_var_mapping, mapping, sizeof(g_var_mapping));
-     const char *p = expr;
-     int result = parse_expression(&p);
-     return result;
+ int run_query(int mode, const char *expr, const char *expr2, int threads) {
+     BddResult r;
+     int rc = mode == MODE_EQUIV || mode == MODE_TAUTOLOGY
+              ? check_equivalence(expr, mode == MODE_EQUIV ? expr2 : NULL, threads, &r)
+              : bdd_analyze(expr, NULL, &r);
+     if (rc != 0) {
+         fprintf(stderr, "Error: Expression too large for a BDD or out of memory.\n");
+         return 1;
+     }
+     unsigned long long total = 1ULL << r.var_count;
+
+     if (mode == MODE_SAT) {
+         if (!r.found) {
+             printf("\nUnsatisfiable\n");
+         } else {
+             printf("\nSatisfiable%s", r.var_count ? ": " : "");
+             print_model(&r);
+             printf("\n");
+         }
+     } else if (mode == MODE_COUNT) {
+         printf("\nSatisfying assignments: %llu of %llu\n",
+                (unsigned long long)r.count, total);
+     } else if (!r.found) {
+         printf(mode == MODE_EQUIV ? "\nEquivalent\n" : "\nTautology\n");
+     } else if (mode == MODE_EQUIV) {
+         printf("\nNot equivalent: ");
+         print_model(&r);
+         printf(" gives %d and %d", r.value, !r.value);
+         if (r.counted) {
+             printf(" (%llu of %llu assignments differ)", (unsigned long long)r.count, total);
+         }
+         printf("\n");
+     } else {
+         printf("\nNot a tautology%s", r.var_count ? ": " : "");
+         print_model(&r);
+         if (r.var_count) {
+             printf(" gives 0");
+         }
+         if (r.counted) {
+             printf(" (%llu of %llu assignments give 0)", (unsigned long long)r.count, total);
+         }
+         printf("\n");
+     }
+     return 0;
  }
- 
+
  /* -------------------------------------------------------------------------
-  * generate_truth_table:
-  *   Generates and prints a truth table for the provided Boolean expression.
-  *   The function scans the expression for unique alphabetic variables, then
-  *   iterates over every possible combination of truth values for these variables,
-  *   evaluates the expression for each combination, and prints the results.
+  * read_expressions:
+  *   Reads the expressions of --multi from stdin, one per line, up to an
+  *   empty line or the end of the input.
   *
-  *   Parameters:
-  *     expr - The Boolean expression.
+  *   Returns:
+  *     The number of expressions read into exprs (free each), or -1 after
+  *     printing an error.
   * ------------------------------------------------------------------------- */
- void generate_truth_table(const char *expr) {
-     // Identify unique variables in the expression.
-     char vars[100];
-     int var_count = 0;
-     memset(vars, 0, sizeof(vars));
-     for (const char *p = expr; *p; p++) {
-         if (isalpha(*p)) {
-             char ch = *p;
-             int already_present = 0;
-             for (int i = 0; i < var_count; i++) {
-                 if (vars[i] == ch) {
-                     already_present = 1;
-                     break;
-                 }
-             }
-             if (!already_present && var_count < 100) {
-                 vars[var_count++] = ch;
-             }
+ static int read_expressions(char *exprs[MAX_OUTPUTS]) {
+     int count = 0;
+     char *line = NULL;
+     size_t capacity = 0;
+     ssize_t len;
+     while ((len = getline(&line, &capacity, stdin)) > 0) {
+         if (line[len - 1] == '\n') {
+             line[--len] = '\0';
+         }
+         if (len == 0) {
+             break;
+         }
+         if (count == MAX_OUTPUTS) {
+             fprintf(stderr, "Error: --multi takes at most %d expressions.\n", MAX_OUTPUTS);
+             count = -1;
+             break;
          }
+         exprs[count++] = line;
+         line = NULL;
+         capacity = 0;
      }
- 
-     // Print table header.
-     printf("\nTruth Table:\n");
-     for (int i = 0; i < var_count; i++) {
-         printf("%c\t", vars[i]);
+     free(line);
+     if (count == 0) {
+         fprintf(stderr, "Error reading expression.\n");
+         return -1;
      }
-     printf("Result\n");
- 
-     // Total number of rows: 2^(number of variables)
-     int total_rows = 1 << var_count;
- 
-     // Iterate over all combinations.
-     for (int i = 0; i < total_rows; i++) {
-         int mapping[256];
-         // Set default: all variables to true.
-         for (int j = 0; j < 256; j++) {
-             mapping[j] = 1;
-         }
-         // Assign truth values for each variable based on the current combination.
-         for (int j = 0; j < var_count; j++) {
-             mapping[(int)vars[j]] = ((i >> (var_count - j - 1)) & 1);
-             printf("%d\t", mapping[(int)vars[j]]);
+     if (count < 0) {
+         for (int i = 0; i < MAX_OUTPUTS; i++) {
+             free(exprs[i]);
          }
-         int result = evaluate_expr_with_mapping(expr, mapping);
-         printf("%d\n", result);
      }
+     return count;
  }
- 
+
+ /* -------------------------------------------------------------------------
+  * parse_threads:
+  *   Parses the thread count given to --threads.
+  *
+  *   Parameters:
+  *     text    - The option's argument.
+  *     threads - Receives the thread count.
+  *
+  *   Returns:
+  *     0 on success, -1 unless the text is a positive decimal number.
+  * ------------------------------------------------------------------------- */
+ int parse_threads(const char *text, int *threads) {
+     char *end;
+     errno = 0;
+     long n = strtol(text, &end, 10);
+     if (end == text || *end != '\0' || errno == ERANGE || n < 1 || n > INT_MAX) {
+         return -1;
+     }
+     *threads = (int)n;
+     return 0;
+ }
+
  /* -------------------------------------------------------------------------
   * print_usage:
   *   Prints usage instructions for the solver.
   * ------------------------------------------------------------------------- */
  void print_usage(const char *progname) {
-     printf("Usage: %s [--truth-table]\n", progname);
+     printf("Usage: %s [--assign A=0,B=1] [--truth-table] [--threads N] [--format F]\n", progname);
+     printf("       %s --truth-table [--only-true | --only-false] [--gray | --gray-order] ...\n", progname);
+     printf("       %s --simplify [--threads N]\n", progname);
+     printf("       %s --sat | --count | --equiv EXPR2 | --tautology [--threads N]\n", progname);
+     printf("       %s --batch [FILE]\n", progname);
+     printf("       %s --columns FILE [--threads N]\n", progname);
+     printf("       %s --multi [--truth-table ... | --columns FILE ...]\n", progname);
+     printf("--assign sets variable values for the evaluation; others default to 1.\n");
      printf("If --truth-table is provided, a truth table for the given expression is generated.\n");
+     printf("--threads N evaluates the truth table on N threads (default 1).\n");
+     printf("--format F prints the truth table as text (default), csv, html or bin.\n");
+     printf("--only-true and --only-false print only the rows with that result.\n");
+     printf("--gray evaluates the table in Gray-code order on one thread, and --gray-order\n");
+     printf("also prints its rows in that order.\n");
+     printf("--batch evaluates one 'EXPR [; A=0,B=1]' per line of FILE or stdin.\n");
+     printf("--columns evaluates every row of a column file and writes the packed results.\n");
+     printf("--multi reads one expression per line, up to an empty line, and evaluates\n");
+     printf("them together, with a result column for each.\n");
+     printf("--simplify prints a minimal sum of products and product of sums.\n");
+     printf("--sat finds a satisfying assignment and --count counts them, without\n");
+     printf("enumerating the truth table.\n");
+     printf("--equiv EXPR2 checks equivalence with EXPR2 and --tautology whether the\n");
+     printf("expression is always true, stopping at the first counterexample.\n");
  }
  
  /* -------------------------------------------------------------------------
@@ -255,10 +715,102 @@
   * ------------------------------------------------------------------------- */
  int main(int argc, char *argv[]) {
      char expression[256];
+     int mode = MODE_EVALUATE;
+     const char *expr2 = NULL;
+     const char *columns = NULL;
+     int threads = 1;
+     const char *assignments = NULL;
+     int format = FORMAT_TEXT;
+     int filter = FILTER_ALL;
+     int order = ORDER_ROWS;
+     int multi = 0;
  
-     printf("Boolean Expression Solver\n");
-     printf("-------------------------\n");
-     printf("Enter a Boolean expression (use '+' for OR, '·' for AND, '!' for NOT):\n");
+     for (int i = 1; i < argc; i++) {
+         if (strcmp(argv[i], "--batch") == 0) {
+             return run_batch(i + 1 < argc ? argv[i + 1] : NULL);
+         } else if (strcmp(argv[i], "--truth-table") == 0) {
+             mode = MODE_TRUTH_TABLE;
+         } else if (strcmp(argv[i], "--only-true") == 0) {
+             filter = FILTER_TRUE;
+         } else if (strcmp(argv[i], "--only-false") == 0) {
+             filter = FILTER_FALSE;
+         } else if (strcmp(argv[i], "--gray") == 0) {
+             order = ORDER_GRAY_EVALUATION;
+         } else if (strcmp(argv[i], "--gray-order") == 0) {
+             order = ORDER_GRAY;
+         } else if (strcmp(argv[i], "--multi") == 0) {
+             multi = 1;
+         } else if (strcmp(argv[i], "--simplify") == 0) {
+             mode = MODE_SIMPLIFY;
+         } else if (strcmp(argv[i], "--sat") == 0) {
+             mode = MODE_SAT;
+         } else if (strcmp(argv[i], "--count") == 0) {
+             mode = MODE_COUNT;
+         } else if (strcmp(argv[i], "--equiv") == 0 && i + 1 < argc) {
+             mode = MODE_EQUIV;
+             expr2 = argv[++i];
+         } else if (strcmp(argv[i], "--tautology") == 0) {
+             mode = MODE_TAUTOLOGY;
+         } else if (strcmp(argv[i], "--columns") == 0 && i + 1 < argc) {
+             mode = MODE_COLUMNS;
+             columns = argv[++i];
+         } else if (strcmp(argv[i], "--threads") == 0 && i + 1 < argc
+                    && parse_threads(argv[i + 1], &threads) == 0) {
+             i++;
+         } else if (strcmp(argv[i], "--assign") == 0 && i + 1 < argc) {
+             assignments = argv[++i];
+         } else if (strcmp(argv[i], "--format") == 0 && i + 1 < argc
+                    && (format = parse_format(argv[i + 1])) >= 0) {
+             i++;
+         } else {
+             print_usage(argv[0]);
+             return 1;
+         }
+     }
+ 
+     if (multi) {
+         if (mode == MODE_EVALUATE) {
+             mode = MODE_TRUTH_TABLE;
+         }
+         if ((mode != MODE_TRUTH_TABLE && mode != MODE_COLUMNS) || order != ORDER_ROWS) {
+             fprintf(stderr, "Error: --multi works with --truth-table and --columns only.\n");
+             return 1;
+         }
+         if (format == FORMAT_BINARY) {
+             fprintf(stderr, "Error: --multi does not support the binary format.\n");
+             return 1;
+         }
+     }
+
+     // Machine-readable tables and result columns are not preceded by the prompt.
+     if (mode != MODE_COLUMNS && (mode != MODE_TRUTH_TABLE || format == FORMAT_TEXT)) {
+         printf("Boolean Expression Solver\n");
+         printf("-------------------------\n");
+         if (multi) {
+             printf("Enter Boolean expressions, one per line, ending with an empty line:\n");
+         } else {
+             printf("Enter a Boolean expression (use '+' for OR, '·' for AND, '!' for NOT):\n");
+         }
+     }
+
+     if (multi) {
+         char *exprs[MAX_OUTPUTS];
+         int count = read_expressions(exprs);
+         if (count < 0) {
+             return 1;
+         }
+         int rc = 0;
+         if (mode == MODE_TRUTH_TABLE) {
+             generate_truth_table((const char *const *)exprs, count, threads, format, filter,
+                                  order);
+         } else {
+             rc = run_columns(columns, (const char *const *)exprs, count, threads);
+         }
+         for (int i = 0; i < count; i++) {
+             free(exprs[i]);
+         }
+         return rc;
+     }
  
      if (fgets(expression, sizeof(expression), stdin) == NULL) {
          fprintf(stderr, "Error reading expression.\n");
@@ -271,12 +823,29 @@
          expression[len - 1] = '\0';
      }
  
-     if (argc > 1 && strcmp(argv[1], "--truth-table") == 0) {
+     if (mode == MODE_TRUTH_TABLE) {
          // Generate and print the truth table for the provided expression.
-         generate_truth_table(expression);
+         const char *exprs[1] = { expression };
+         generate_truth_table(exprs, 1, threads, format, filter, order);
+     } else if (mode == MODE_SIMPLIFY) {
+         return simplify_expression(expression, threads);
+     } else if (mode == MODE_COLUMNS) {
+         const char *exprs[1] = { expression };
+         return run_columns(columns, exprs, 1, threads);
+     } else if (mode != MODE_EVALUATE) {
+         return run_query(mode, expression, expr2, threads);
      } else {
-         // Evaluate the expression with default variable values (true).
-         int result = evaluate_boolean_expression(expression);
+         // Evaluate the expression; unassigned variables default to true.
+         int result;
+         int rc = evaluate_with_assignments(expression, assignments, &result);
+         if (rc == -1) {
+             fprintf(stderr, "Error: Invalid variable assignments '%s'.\n", assignments);
+             return 1;
+         }
+         if (rc != 0) {
+             fprintf(stderr, "Error: Out of memory.\n");
+             return 1;
+         }
          printf("\nEvaluation Result: %d\n", result);
      }
  
@@ -0,0 +1,123 @@
+/*
+ * wasm.c - WebAssembly entry points of the Boolean Expression Solver
+ *
+ * Built with boolsolve.c by "make wasm" into boolsolve.js and
+ * boolsolve.wasm, which script.js loads so that the web page evaluates
+ * expressions and builds truth tables in the browser, with the same
+ * compiler, optimizer and bitsliced engine as the solver and server.cgi.
+ * The 512-bit words of the engine are compiled to WebAssembly SIMD
+ * instructions. Everything runs on the page's thread, as threads in a
+ * browser need a cross-origin isolated page, and each call compiles its
+ * expression afresh, which costs far less than the rows it evaluates.
+ */
+
+ #include "boolsolve.h"
+
+ #include <stdlib.h>
+
+ /* The page last returned by bs_truth_table_page */
+ static char *page;
+
+ /* Why the last call failed, see bs_last_error */
+ static const char *last_error = "";
+
+ /* -------------------------------------------------------------------------
+  * bs_last_error:
+  *   Returns a message saying why the last bs_evaluate or
+  *   bs_truth_table_page call failed.
+  * ------------------------------------------------------------------------- */
+ const char *bs_last_error(void) {
+     return last_error;
+ }
+
+ /* -------------------------------------------------------------------------
+  * bs_evaluate:
+  *   Evaluates a Boolean expression like evaluate_with_assignments.
+  *
+  *   Parameters:
+  *     expr        - The Boolean expression as a string.
+  *     assignments - An assignment list such as "A=0,B=1", or NULL to give
+  *                   every variable the value 1.
+  *
+  *   Returns:
+  *     The result (0 or 1), or -1 if the expression could not be compiled,
+  *     the list is malformed or memory ran out; see bs_last_error.
+  * ------------------------------------------------------------------------- */
+ int bs_evaluate(const char *expr, const char *assignments) {
+     Program prog;
+     if (compile_expression(expr, &prog) != 0) {
+         last_error = "The expression could not be compiled.";
+         return -1;
+     }
+     Evaluator ev;
+     if (evaluator_init(&ev, &prog) != 0) {
+         last_error = "Out of memory.";
+         free_program(&prog);
+         return -1;
+     }
+     ev.values = ~0ULL;
+     int result = -1;
+     if (assignments && apply_assignments(&ev, assignments) != 0) {
+         last_error = "Invalid variable assignments.";
+     } else {
+         result = evaluator_run(&ev);
+     }
+     evaluator_free(&ev);
+     free_program(&prog);
+     return result;
+ }
+
+ /* -------------------------------------------------------------------------
+  * bs_truth_table_page:
+  *   Builds a page of the HTML truth table of a Boolean expression, laid
+  *   out like a page from server.cgi in mode=tt: a div whose data attributes
+  *   give the first row, its number of rows and the size of the whole
+  *   table, around a table of the header and the rows in view.
+  *
+  *   Parameters:
+  *     expr   - The Boolean expression as a string.
+  *     offset - The first row of the page (clipped to the table).
+  *     limit  - The most rows on the page.
+  *
+  *   Returns:
+  *     The page, valid until the next call, or NULL if the expression could
+  *     not be compiled or memory ran out; see bs_last_error.
+  * ------------------------------------------------------------------------- */
+ const char *bs_truth_table_page(const char *expr, double offset, double limit) {
+     free(page);
+     page = NULL;
+     Program prog;
+     if (compile_expression(expr, &prog) != 0) {
+         last_error = "The expression could not be compiled.";
+         return NULL;
+     }
+     optimize_program(&prog);
+     // Every later failure is for lack of memory.
+     last_error = "Out of memory.";
+
+     uint64_t total = 1ULL << prog.var_count;
+     uint64_t first = offset < (double)total ? (uint64_t)offset : total;
+     uint64_t rows = limit < (double)(total - first) ? (uint64_t)limit : total - first;
+     size_t size;
+     FILE *out = open_memstream(&page, &size);
+     if (!out) {
+         free_program(&prog);
+         return NULL;
+     }
+     TableWriter writer;
+     int rc = writer_init(&writer, FORMAT_HTML, &prog, -1, out);
+     if (rc == 0) {
+         fprintf(out, "<div class='truth-table' data-offset='%llu' data-rows='%llu'"
+                 " data-total-rows='%llu'>", (unsigned long long)first,
+                 (unsigned long long)rows, (unsigned long long)total);
+         rc = parallel_truth_range(&prog, 1, first, rows, writer_rows, &writer);
+         writer_finish(&writer);
+         fprintf(out, "</div>");
+     }
+     free_program(&prog);
+     if (fclose(out) != 0 || rc != 0) {
+         free(page);
+         page = NULL;
+     }
+     return page;
+ }